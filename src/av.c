@@ -86,6 +86,11 @@ int av_eof(av_t *s)
 	return(s->read_video == NULL && s->read_audio == NULL ? 1 : 0);
 }
 
+int av_abort(av_t *s)
+{
+	return(s->abort ? s->abort(s->av_source_ctx) : AV_OK);
+}
+
 int av_close(av_t *s)
 {
 	int r;
@@ -95,6 +100,7 @@ int av_close(av_t *s)
 	s->av_source_ctx = NULL;
 	s->read_video = NULL;
 	s->read_audio = NULL;
+	s->abort = NULL;
 	s->close = NULL;
 	
 	return(r);
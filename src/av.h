@@ -69,6 +69,12 @@ typedef int (*av_read_video_t)(void *ctx, av_frame_t *frame);
 
 typedef int (*av_read_audio_t)(void *ctx, int16_t **samples, size_t *nsamples);
 
+/* av_abort(): Release any thread blocked reading from the source. Further
+ *             reads return AV_EOF. The source remains open until av_close().
+ *             Optional. The return code is ignored */
+
+typedef int (*av_abort_t)(void *ctx);
+
 /* av_close(): The source is being closed. The return code is ignored */
 
 typedef int (*av_close_t)(void *ctx);
@@ -111,6 +117,7 @@ typedef struct {
 	void *av_source_ctx;
 	av_read_video_t read_video;
 	av_read_audio_t read_audio;
+	av_abort_t abort;
 	av_close_t close;
 	
 } av_t;
@@ -120,6 +127,7 @@ extern void av_frame_init(av_frame_t *frame, int width, int height, uint32_t *fr
 extern int av_read_video(av_t *s, av_frame_t *frame);
 extern int av_read_audio(av_t *s, int16_t **samples, size_t *nsamples);
 extern int av_eof(av_t *s);
+extern int av_abort(av_t *s);
 extern int av_close(av_t *s);
 
 extern r64_t av_display_aspect_ratio(av_frame_t *frame);
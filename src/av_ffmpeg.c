@@ -931,21 +931,40 @@ static int _ffmpeg_read_audio(void *ctx, int16_t **samples, size_t *nsamples)
 	return(AV_OK);
 }
 
-static int _ffmpeg_close(void *ctx)
+static int _ffmpeg_abort(void *ctx)
 {
 	av_ffmpeg_t *s = ctx;
 	
+	/* Stop all threads, and any reader waiting on a frame */
 	s->thread_abort = 1;
 	_packet_queue_abort(s, &s->video_queue);
 	_packet_queue_abort(s, &s->audio_queue);
 	
-	pthread_join(s->input_thread, NULL);
-	
 	if(s->video_stream != NULL)
 	{
 		_frame_dbuffer_abort(&s->in_video_buffer);
 		_frame_dbuffer_abort(&s->out_video_buffer);
-		
+	}
+	
+	if(s->audio_stream != NULL)
+	{
+		_frame_dbuffer_abort(&s->in_audio_buffer);
+		_frame_dbuffer_abort(&s->out_audio_buffer);
+	}
+	
+	return(AV_OK);
+}
+
+static int _ffmpeg_close(void *ctx)
+{
+	av_ffmpeg_t *s = ctx;
+	
+	_ffmpeg_abort(s);
+	
+	pthread_join(s->input_thread, NULL);
+	
+	if(s->video_stream != NULL)
+	{
 		pthread_join(s->video_decode_thread, NULL);
 		pthread_join(s->video_scaler_thread, NULL);
 		
@@ -962,9 +981,6 @@ static int _ffmpeg_close(void *ctx)
 	
 	if(s->audio_stream != NULL)
 	{
-		_frame_dbuffer_abort(&s->in_audio_buffer);
-		_frame_dbuffer_abort(&s->out_audio_buffer);
-		
 		pthread_join(s->audio_decode_thread, NULL);
 		pthread_join(s->audio_scaler_thread, NULL);
 		
@@ -1246,6 +1262,7 @@ int av_ffmpeg_open(av_t *av, char *input_url, char *format, char *options)
 	av->av_source_ctx = s;
 	av->read_video = s->video_stream != NULL ? _ffmpeg_read_video : NULL;
 	av->read_audio = s->audio_stream != NULL ? _ffmpeg_read_audio : NULL;
+	av->abort = _ffmpeg_abort;
 	av->close = _ffmpeg_close;
 	
 	/* Start the threads */
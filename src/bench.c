@@ -0,0 +1,1019 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* hacktv-bench - Microbenchmarks for the encoder's DSP kernels
+ *
+ * Each kernel is run repeatedly on synthetic input for a fixed time,
+ * and the result printed as a JSON line on stdout:
+ *
+ * {"bench":"<name>","params":"<params>","samples":n,"ns_per_sample":x,"msps":y}
+ *
+ * The whole encoder is also run for each mode in vid_configs, with
+ * the time spent in each line process reported in the same way.
+ *
+ * With --check, the SIMD kernels are instead compared with their
+ * scalar versions, and the exit status is non-zero on any difference.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+#include <math.h>
+#include "video.h"
+#include "av_test.h"
+#include "rf.h"
+#include "rf_simd.h"
+#include "fir_simd.h"
+#include "cpu.h"
+#include "spdif.h"
+
+/* Length of the lines of test data */
+#define BENCH_WIDTH 1024
+
+typedef void (*_bench_fn_t)(void *arg);
+
+typedef struct {
+	double seconds;
+	unsigned int sample_rate;
+	const char *filter;
+	int check;
+} _bench_conf_t;
+
+static _bench_conf_t _conf;
+
+static int16_t _in[BENCH_WIDTH * 2];
+static int16_t _out[BENCH_WIDTH * 2 * 4];
+
+static uint64_t _clock_ns(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int _bench_skip(const char *name)
+{
+	return(_conf.filter != NULL && strstr(name, _conf.filter) == NULL);
+}
+
+static void _bench_print(const char *name, const char *params, uint64_t samples, uint64_t ns)
+{
+	double nps = samples ? (double) ns / samples : 0;
+	double msps = ns ? (double) samples / ns * 1e3 : 0;
+	
+	printf("{\"bench\":\"%s\",\"params\":\"%s\",\"samples\":%" PRIu64 ",\"ns_per_sample\":%.3f,\"msps\":%.3f}\n",
+		name, params, samples, nps, msps);
+	fflush(stdout);
+}
+
+static void _bench_run(const char *name, const char *params, _bench_fn_t fn, void *arg, int samples)
+{
+	uint64_t start, end, t;
+	uint64_t n;
+	
+	/* Warm up the caches and any lazily allocated state */
+	fn(arg);
+	
+	start = _clock_ns();
+	end = start + (uint64_t) (_conf.seconds * 1e9);
+	
+	for(n = 0, t = start; t < end; t = _clock_ns())
+	{
+		/* Check the clock every few calls for the short kernels */
+		for(int i = 0; i < 16; i++)
+		{
+			fn(arg);
+		}
+		
+		n += 16;
+	}
+	
+	_bench_print(name, params, n * samples, t - start);
+}
+
+/* FIR filters */
+
+static void _fir_int16_fn(void *arg)
+{
+	fir_int16_t *f = arg;
+	
+	fir_int16_feed(f, _in, BENCH_WIDTH, 2);
+	fir_int16_process(f, _out, 0, 2);
+}
+
+static void _fir_int16_block_fn(void *arg)
+{
+	fir_int16_process_block(arg, _out, _in, BENCH_WIDTH, 2);
+}
+
+static void _bench_fir_int16(void)
+{
+	static const int ntaps[] = { 15, 51, 127, 401 };
+	double taps[401 * 2];
+	char params[64], bparams[64];
+	fir_int16_t f;
+	int i, delay;
+	
+	for(i = 0; i < sizeof(ntaps) / sizeof(int); i++)
+	{
+		/* Delay the output to the end of the line, as the
+		 * encoder does for its video filters */
+		delay = BENCH_WIDTH - ntaps[i] / 2;
+		
+		sprintf(params, "ntaps=%d,delay=%d", ntaps[i], delay);
+		sprintf(bparams, "ntaps=%d", ntaps[i]);
+		
+		fir_low_pass(taps, ntaps[i], _conf.sample_rate, 5.0e6, 0.75e6, 1);
+		
+		if(!_bench_skip("fir_int16_process"))
+		{
+			fir_int16_init(&f, taps, ntaps[i], 1, 1, delay);
+			_bench_run("fir_int16_process", params, _fir_int16_fn, &f, BENCH_WIDTH);
+			fir_int16_free(&f);
+		}
+		
+		if(!_bench_skip("fir_int16_process_block"))
+		{
+			/* Block filters are aligned to their input */
+			fir_int16_init(&f, taps, ntaps[i], 1, 1, 0);
+			_bench_run("fir_int16_process_block", bparams, _fir_int16_block_fn, &f, BENCH_WIDTH);
+			fir_int16_free(&f);
+		}
+		
+		fir_complex_band_pass(taps, ntaps[i], _conf.sample_rate, -1.25e6, 5.0e6, 0.75e6, 1);
+		
+		if(!_bench_skip("fir_int16_complex_process"))
+		{
+			fir_int16_complex_init(&f, taps, ntaps[i], 1, 1, delay);
+			_bench_run("fir_int16_complex_process", params, _fir_int16_fn, &f, BENCH_WIDTH);
+			fir_int16_free(&f);
+		}
+		
+		if(!_bench_skip("fir_int16_scomplex_process"))
+		{
+			fir_int16_scomplex_init(&f, taps, ntaps[i], 1, 1, delay);
+			_bench_run("fir_int16_scomplex_process", params, _fir_int16_fn, &f, BENCH_WIDTH);
+			fir_int16_free(&f);
+		}
+	}
+	
+	if(!_bench_skip("fir_int16_resampler"))
+	{
+		/* The ratio used for the D/D2-MAC modes */
+		fir_int16_resampler_init(&f, (r64_t) { 20250000, 1 }, (r64_t) { 16000000, 1 });
+		_bench_run("fir_int16_resampler", "16000000:20250000", _fir_int16_fn, &f, BENCH_WIDTH);
+		fir_int16_free(&f);
+	}
+}
+
+static void _fir_int32_fn(void *arg)
+{
+	static int32_t in[BENCH_WIDTH * 2];
+	static int32_t out[BENCH_WIDTH * 2];
+	
+	fir_int32_process(arg, out, in, BENCH_WIDTH);
+}
+
+static void _bench_fir_int32(void)
+{
+	static const int ntaps[] = { 21, 65 };
+	double taps[65];
+	char params[64];
+	fir_int32_t f;
+	int i;
+	
+	if(_bench_skip("fir_int32_process")) return;
+	
+	for(i = 0; i < sizeof(ntaps) / sizeof(int); i++)
+	{
+		sprintf(params, "ntaps=%d", ntaps[i]);
+		
+		fir_low_pass(taps, ntaps[i], 32000, 15000, 1000, 1);
+		fir_int32_init(&f, taps, ntaps[i], 1, 1, 0);
+		_bench_run("fir_int32_process", params, _fir_int32_fn, &f, BENCH_WIDTH);
+		fir_int32_free(&f);
+	}
+}
+
+static void _iir_int16_fn(void *arg)
+{
+	iir_int16_process(arg, _out, _in, BENCH_WIDTH, 1);
+}
+
+static void _bench_iir_int16(void)
+{
+	const double a[2] = { 1.0, -0.5 };
+	const double b[2] = { 1.5, -1.0 };
+	iir_int16_t f;
+	
+	if(_bench_skip("iir_int16_process")) return;
+	
+	iir_int16_init(&f, a, b);
+	_bench_run("iir_int16_process", "", _iir_int16_fn, &f, BENCH_WIDTH);
+	iir_int16_free(&f);
+}
+
+static int16_t _limiter_in[BENCH_WIDTH];
+
+static void _limiter_fn(void *arg)
+{
+	limiter_process(arg, _out, _limiter_in, _limiter_in, BENCH_WIDTH, 1);
+}
+
+static void _bench_limiter(void)
+{
+	double taps[65];
+	double v;
+	limiter_t l;
+	int i;
+	
+	if(_bench_skip("limiter_process")) return;
+	
+	/* Overdriven audio: two tones at three times full scale, clipped.
+	 * Both have a whole number of cycles in the block so it repeats
+	 * without a step. The input stays over the limit for long runs
+	 * either side of each peak, as with loud compressed material */
+	for(i = 0; i < BENCH_WIDTH; i++)
+	{
+		v = 0.7 * sin(2.0 * M_PI * 32 * i / BENCH_WIDTH) +
+		    0.3 * sin(2.0 * M_PI * 10 * i / BENCH_WIDTH);
+		v *= 3.0 * INT16_MAX;
+		_limiter_in[i] = v < -INT16_MAX ? -INT16_MAX : (v > INT16_MAX ? INT16_MAX : v);
+	}
+	
+	fir_low_pass(taps, 65, 32000, 15000, 1000, 1);
+	limiter_init(&l, INT16_MAX / 2, 21, taps, taps, 65);
+	_bench_run("limiter_process", "ntaps=65,clipped=1000+312.5Hz", _limiter_fn, &l, BENCH_WIDTH);
+	limiter_free(&l);
+}
+
+/* VBI data */
+
+typedef struct {
+	vbidata_lut_t *lut;
+	uint8_t data[45];
+	vid_line_t lines[3];
+} _vbidata_bench_t;
+
+static void _vbidata_fn(void *arg)
+{
+	_vbidata_bench_t *v = arg;
+	
+	vbidata_render(v->lut, v->data, 0, 360, VBIDATA_LSB_FIRST, &v->lines[1]);
+}
+
+static void _bench_vbidata(void)
+{
+	_vbidata_bench_t v;
+	int i;
+	
+	if(_bench_skip("vbidata_render")) return;
+	
+	/* A line of teletext */
+	v.lut = vbidata_init(
+		360, BENCH_WIDTH, INT16_MAX / 2,
+		VBIDATA_FILTER_RC, (double) BENCH_WIDTH / 444, 0.7,
+		BENCH_WIDTH / 64.0 * (12 - (64.0 / 444 * 12))
+	);
+	
+	for(i = 0; i < sizeof(v.data); i++)
+	{
+		v.data[i] = rand();
+	}
+	
+	for(i = 0; i < 3; i++)
+	{
+		memset(&v.lines[i], 0, sizeof(vid_line_t));
+		v.lines[i].output = &_out[BENCH_WIDTH * 2 * i];
+		v.lines[i].width = BENCH_WIDTH;
+		v.lines[i].previous = &v.lines[i > 0 ? i - 1 : 0];
+		v.lines[i].next = &v.lines[i < 2 ? i + 1 : 2];
+	}
+	
+	_bench_run("vbidata_render", "teletext", _vbidata_fn, &v, BENCH_WIDTH);
+	
+	free(v.lut);
+}
+
+/* Digital audio modulators */
+
+static void _nicam_fn(void *arg)
+{
+	nicam_mod_input(arg, _in);
+	nicam_mod_output(arg, _out, BENCH_WIDTH);
+}
+
+static void _dance_fn(void *arg)
+{
+	dance_mod_input(arg, _in);
+	dance_mod_output(arg, _out, BENCH_WIDTH);
+}
+
+static void _spdif_fn(void *arg)
+{
+	spdif_block(arg, _in);
+}
+
+static void _bench_audio(void)
+{
+	nicam_mod_t n;
+	dance_mod_t d;
+	uint8_t b[SPDIF_BLOCK_BYTES];
+	
+	if(!_bench_skip("nicam_mod_output"))
+	{
+		nicam_mod_init(&n, NICAM_MODE_STEREO, 1, _conf.sample_rate, 6552000, 1.0, 0.2);
+		_bench_run("nicam_mod_output", "", _nicam_fn, &n, BENCH_WIDTH);
+		nicam_mod_free(&n);
+	}
+	
+	if(!_bench_skip("dance_mod_output"))
+	{
+		dance_mod_init(&d, DANCE_MODE_A, _conf.sample_rate, 6552000, 1.0, 0.2);
+		_bench_run("dance_mod_output", "", _dance_fn, &d, BENCH_WIDTH);
+		dance_mod_free(&d);
+	}
+	
+	if(!_bench_skip("spdif_block"))
+	{
+		_bench_run("spdif_block", "", _spdif_fn, b, SPDIF_BLOCK_SAMPLES);
+	}
+}
+
+/* File output converters */
+
+static void _rf_file_fn(void *arg)
+{
+	rf_write(arg, _in, BENCH_WIDTH);
+}
+
+static void _bench_rf_file(void)
+{
+	static const char *types[] = { "uint8", "int8", "uint16", "int16", "int32", "float" };
+	const int ids[] = { RF_UINT8, RF_INT8, RF_UINT16, RF_INT16, RF_INT32, RF_FLOAT };
+	char name[64];
+	rf_t rf;
+	int i, c;
+	
+	for(c = 0; c < 2; c++)
+	{
+		for(i = 0; i < sizeof(ids) / sizeof(int); i++)
+		{
+			sprintf(name, "rf_file_write_%s_%s", types[i], c ? "complex" : "real");
+			if(_bench_skip(name)) continue;
+			
+			/* The output is discarded by the OS */
+			if(rf_file_open(&rf, "/dev/null", ids[i], c) != RF_OK) continue;
+			_bench_run(name, "", _rf_file_fn, &rf, BENCH_WIDTH);
+			rf_close(&rf);
+		}
+	}
+}
+
+static rf_convert_t _rf_convert;
+
+static void _rf_convert_fn(void *arg)
+{
+	_rf_convert(_out, _in, BENCH_WIDTH);
+}
+
+static void _bench_rf_convert(void)
+{
+	static const char *types[] = { "uint8", "int8", "uint16", "int16", "int32", "float" };
+	const int ids[] = { RF_UINT8, RF_INT8, RF_UINT16, RF_INT16, RF_INT32, RF_FLOAT };
+	const struct {
+		const char *name;
+		int features;
+	} isas[] = {
+		{ "scalar", 0 },
+		{ "sse2", CPU_SSE2 },
+		{ "avx2", CPU_SSE2 | CPU_AVX2 },
+		{ "neon", CPU_NEON },
+	};
+	char name[64];
+	char params[64];
+	int f = cpu_features();
+	int i, j, c;
+	
+	for(c = 0; c < 2; c++)
+	{
+		for(i = 0; i < sizeof(ids) / sizeof(int); i++)
+		{
+			sprintf(name, "rf_convert_%s_%s", types[i], c ? "complex" : "real");
+			if(_bench_skip(name)) continue;
+			
+			/* Each instruction set supported by this CPU */
+			for(j = 0; j < sizeof(isas) / sizeof(isas[0]); j++)
+			{
+				if((isas[j].features & f) != isas[j].features) continue;
+				
+				sprintf(params, "isa=%s", isas[j].name);
+				_rf_convert = rf_convert_kernel(ids[i], c, isas[j].features);
+				_bench_run(name, params, _rf_convert_fn, NULL, BENCH_WIDTH);
+			}
+		}
+	}
+}
+
+/* Modes */
+
+static void _bench_mode(const vid_configs_t *vc)
+{
+	static vid_t s;
+	vid_config_t conf;
+	uint64_t start, end, t, n;
+	char params[64];
+	vid_line_t *l;
+	int i;
+	
+	conf = *vc->conf;
+	conf.stats = VID_STATS_QUIET;
+	
+	if(vid_init(&s, _conf.sample_rate, 0, &conf) != VID_OK)
+	{
+		fprintf(stderr, "%s: Unable to initialise video encoder\n", vc->id);
+		return;
+	}
+	
+	s.av = (av_t) {
+		.frame_rate = (r64_t) {
+			.num = s.conf.frame_rate.num * (s.conf.interlace ? 2 : 1),
+			.den = s.conf.frame_rate.den,
+		},
+		.display_aspect_ratios = {
+			s.conf.frame_aspects[0],
+			s.conf.frame_aspects[1]
+		},
+		.fit_mode = AV_FIT_STRETCH,
+		.width = s.active_width,
+		.height = s.conf.active_lines,
+		.sample_rate = (r64_t) { 32000, 1 },
+	};
+	
+	if((s.conf.frame_orientation & 3) == VID_ROTATE_90 ||
+	   (s.conf.frame_orientation & 3) == VID_ROTATE_270)
+	{
+		s.av.width = s.conf.active_lines;
+		s.av.height = s.active_width;
+	}
+	
+	if(av_test_open(&s.av) != AV_OK)
+	{
+		vid_free(&s);
+		return;
+	}
+	
+	start = _clock_ns();
+	end = start + (uint64_t) (_conf.seconds * 1e9);
+	
+	for(n = 0, t = start; t < end; t = _clock_ns())
+	{
+		l = vid_next_line(&s);
+		if(l == NULL) break;
+		n += l->width;
+	}
+	
+	sprintf(params, "mode=%s", vc->id);
+	_bench_print("vid_next_line", params, n, t - start);
+	
+	/* Report the time spent in each line process */
+	for(i = 0; i < s.nprocesses; i++)
+	{
+		_lineprocess_t *p = &s.processes[i];
+		uint64_t nlines = atomic_load(&p->nlines_done);
+		
+		sprintf(params, "mode=%s,process=%s", vc->id, p->name);
+		_bench_print("vid_lineprocess", params, nlines * s.width, atomic_load(&p->process_ns));
+	}
+	
+	vid_free(&s);
+}
+
+static void _bench_modes(void)
+{
+	const vid_configs_t *vc;
+	
+	if(_bench_skip("vid_")) return;
+	
+	for(vc = vid_configs; vc->id != NULL; vc++)
+	{
+		_bench_mode(vc);
+	}
+}
+
+/* Equivalence checks
+ *
+ * Each SIMD kernel supported by this CPU is run on random input, with
+ * the int16 edge values mixed in, and its output compared with the
+ * scalar version. Every length up to 64 samples is checked, then full
+ * lines at each alignment. The result is printed as a JSON line:
+ *
+ * {"check":"<name>","params":"<params>","samples":n,"errors":e}
+ *
+ * where errors is the number of runs with a different output.
+*/
+
+#define CHECK_RUNS 80
+
+static const struct {
+	const char *isa;
+	int features;
+	vid_rgb_kernel_t rgb;
+	vid_mix_kernel_t mix;
+	vid_nco_kernel_t nco;
+	vid_cmul_kernel_t cmul;
+} _vid_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	{ "sse41", CPU_SSE41, NULL, vid_mix_sse41, NULL, NULL },
+	{ "avx2", CPU_AVX2, vid_rgb_avx2, vid_mix_avx2, vid_nco_avx2, vid_cmul_avx2 },
+#endif
+#if defined(__ARM_NEON)
+	{ "neon", CPU_NEON, NULL, vid_mix_neon, NULL, vid_cmul_neon },
+#endif
+	{ NULL }
+};
+
+static const struct {
+	const char *isa;
+	int features;
+	fir_int16_dot_t dot;
+	fir_int16_dot2_t dot2;
+} _fir_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	{ "sse2", CPU_SSE2, fir_dot_sse2, fir_dot2_sse2 },
+	{ "avx2", CPU_AVX2, fir_dot_avx2, fir_dot2_avx2 },
+#endif
+#if defined(__ARM_NEON)
+	{ "neon", CPU_NEON, fir_dot_neon, fir_dot2_neon },
+#endif
+	{ NULL }
+};
+
+static int _check_failed;
+
+static void _check_print(const char *name, const char *params, uint64_t samples, int errors)
+{
+	printf("{\"check\":\"%s\",\"params\":\"%s\",\"samples\":%" PRIu64 ",\"errors\":%d}\n",
+		name, params, samples, errors);
+	fflush(stdout);
+	
+	if(errors) _check_failed = 1;
+}
+
+static int _check_len(int run)
+{
+	/* Short runs exercise the scalar tails */
+	return(run <= 64 ? run : BENCH_WIDTH - (run & 7));
+}
+
+static int16_t _check_int16(int16_t min)
+{
+	static const int16_t edges[] = { INT16_MIN, INT16_MIN + 1, -1, 0, 1, INT16_MAX };
+	int16_t v;
+	
+	v = rand() & 3 ? rand() : edges[rand() % 6];
+	
+	return(v < min ? min : v);
+}
+
+static uint32_t _check_uint32(void)
+{
+	static const uint32_t edges[] = { 0x00000000, 0x3FFFFFFF, 0x40000000, 0x7FFFFFFF, 0x80000000, 0xBFFFFFFF, 0xC0000000, 0xFFFFFFFF };
+	
+	return(rand() & 3 ? ((uint32_t) rand() << 16) ^ rand() : edges[rand() % 8]);
+}
+
+static void _check_fill(int16_t *a, int n, int16_t min)
+{
+	while(n--) *(a++) = _check_int16(min);
+}
+
+static int _check_vid_rgb(const vid_t *s, vid_rgb_kernel_t fn, uint64_t *samples)
+{
+	static uint32_t rgb[BENCH_WIDTH * 2 + 8];
+	static int16_t o[2][BENCH_WIDTH * 2 + 16];
+	static int16_t oc[2][BENCH_WIDTH * 2 + 16];
+	int run, n, a, stride, i, errors = 0;
+	
+	for(run = 0; run <= CHECK_RUNS; run++)
+	{
+		n = _check_len(run);
+		a = run & 7;
+		stride = run & 1 ? 2 : 1;
+		
+		for(i = 0; i < BENCH_WIDTH * 2 + 8; i++)
+		{
+			rgb[i] = _check_uint32();
+		}
+		
+		_check_fill(o[0], BENCH_WIDTH * 2 + 16, INT16_MIN);
+		_check_fill(oc[0], BENCH_WIDTH * 2 + 16, INT16_MIN);
+		memcpy(o[1], o[0], sizeof(o[0]));
+		memcpy(oc[1], oc[0], sizeof(oc[0]));
+		
+		/* The chrominance is not needed for every line */
+		vid_rgb_scalar(s, &o[0][a * 2], run & 2 ? NULL : &oc[0][a * 2], &rgb[a], stride, n);
+		fn(s, &o[1][a * 2], run & 2 ? NULL : &oc[1][a * 2], &rgb[a], stride, n);
+		
+		if(memcmp(o[0], o[1], sizeof(o[0])) != 0 ||
+		   memcmp(oc[0], oc[1], sizeof(oc[0])) != 0)
+		{
+			errors++;
+		}
+		
+		*samples += n;
+	}
+	
+	return(errors);
+}
+
+static int _check_vid_nco(const cint16_t *lut, vid_nco_kernel_t fn, uint64_t *samples)
+{
+	static uint32_t phase[BENCH_WIDTH + 8];
+	static int16_t o[2][BENCH_WIDTH * 2 + 16];
+	int run, n, a, i, errors = 0;
+	
+	for(run = 0; run <= CHECK_RUNS; run++)
+	{
+		n = _check_len(run);
+		a = run & 7;
+		
+		for(i = 0; i < BENCH_WIDTH + 8; i++)
+		{
+			phase[i] = _check_uint32();
+		}
+		
+		_check_fill(o[0], BENCH_WIDTH * 2 + 16, INT16_MIN);
+		memcpy(o[1], o[0], sizeof(o[0]));
+		
+		vid_nco_scalar(&o[0][a * 2], &phase[a], lut, n);
+		fn(&o[1][a * 2], &phase[a], lut, n);
+		
+		if(memcmp(o[0], o[1], sizeof(o[0])) != 0) errors++;
+		
+		*samples += n;
+	}
+	
+	return(errors);
+}
+
+static void _check_vid_modes(void)
+{
+	static vid_t s;
+	const vid_configs_t *vc;
+	const _mod_fm_t *fm[6];
+	uint64_t samples[2];
+	int errors[2];
+	char params[64];
+	int k, i, e;
+	
+	for(k = 0; _vid_kernels[k].isa != NULL; k++)
+	{
+		if((cpu_features() & _vid_kernels[k].features) == 0) continue;
+		if(_vid_kernels[k].rgb == NULL && _vid_kernels[k].nco == NULL) continue;
+		
+		memset(samples, 0, sizeof(samples));
+		memset(errors, 0, sizeof(errors));
+		
+		/* The lookup tables of every mode */
+		for(vc = vid_configs; vc->id != NULL; vc++)
+		{
+			if(vid_init(&s, _conf.sample_rate, 0, vc->conf) != VID_OK)
+			{
+				continue;
+			}
+			
+			if(_vid_kernels[k].rgb)
+			{
+				e = _check_vid_rgb(&s, _vid_kernels[k].rgb, &samples[0]);
+				if(e) fprintf(stderr, "vid_rgb: isa=%s differs in mode %s\n", _vid_kernels[k].isa, vc->id);
+				errors[0] += e;
+			}
+			
+			fm[0] = &s.fm_video;
+			fm[1] = &s.fm_mono;
+			fm[2] = &s.fm_left;
+			fm[3] = &s.fm_right;
+			fm[4] = &s.fm_secam;
+			fm[5] = &s.offset;
+			
+			for(i = 0; _vid_kernels[k].nco && i < 6; i++)
+			{
+				if(fm[i]->lut == NULL) continue;
+				
+				e = _check_vid_nco(fm[i]->lut, _vid_kernels[k].nco, &samples[1]);
+				if(e) fprintf(stderr, "vid_nco: isa=%s differs in mode %s\n", _vid_kernels[k].isa, vc->id);
+				errors[1] += e;
+			}
+			
+			vid_free(&s);
+		}
+		
+		sprintf(params, "isa=%s", _vid_kernels[k].isa);
+		if(_vid_kernels[k].rgb) _check_print("vid_rgb", params, samples[0], errors[0]);
+		if(_vid_kernels[k].nco) _check_print("vid_nco", params, samples[1], errors[1]);
+	}
+}
+
+static void _check_vid_mix(void)
+{
+	static int16_t o[2][BENCH_WIDTH * 2 + 16];
+	static int16_t oc[BENCH_WIDTH * 2 + 16];
+	static cint16_t lut[BENCH_WIDTH + 8];
+	uint64_t samples;
+	char params[64];
+	int k, run, n, a, pal, errors;
+	
+	for(k = 0; _vid_kernels[k].isa != NULL; k++)
+	{
+		if((cpu_features() & _vid_kernels[k].features) == 0) continue;
+		if(_vid_kernels[k].mix == NULL) continue;
+		
+		for(samples = 0, errors = 0, run = 0; run <= CHECK_RUNS; run++)
+		{
+			n = _check_len(run);
+			a = run & 7;
+			pal = run & 1 ? -1 : 1;
+			
+			/* The subcarrier never reaches INT16_MIN */
+			_check_fill((int16_t *) lut, (BENCH_WIDTH + 8) * 2, -INT16_MAX);
+			_check_fill(oc, BENCH_WIDTH * 2 + 16, INT16_MIN);
+			_check_fill(o[0], BENCH_WIDTH * 2 + 16, INT16_MIN);
+			memcpy(o[1], o[0], sizeof(o[0]));
+			
+			vid_mix_scalar(&o[0][a * 2], &oc[a * 2], &lut[a], pal, n);
+			_vid_kernels[k].mix(&o[1][a * 2], &oc[a * 2], &lut[a], pal, n);
+			
+			if(memcmp(o[0], o[1], sizeof(o[0])) != 0) errors++;
+			
+			samples += n;
+		}
+		
+		sprintf(params, "isa=%s", _vid_kernels[k].isa);
+		_check_print("vid_mix", params, samples, errors);
+	}
+}
+
+static void _check_vid_cmul(void)
+{
+	static int16_t o[2][BENCH_WIDTH * 2 + 16];
+	static int16_t c[BENCH_WIDTH * 2 + 16];
+	uint64_t samples;
+	char params[64];
+	int k, run, n, a, errors;
+	
+	for(k = 0; _vid_kernels[k].isa != NULL; k++)
+	{
+		if((cpu_features() & _vid_kernels[k].features) == 0) continue;
+		if(_vid_kernels[k].cmul == NULL) continue;
+		
+		for(samples = 0, errors = 0, run = 0; run <= CHECK_RUNS; run++)
+		{
+			n = _check_len(run);
+			a = run & 7;
+			
+			/* The carrier never reaches INT16_MIN */
+			_check_fill(c, BENCH_WIDTH * 2 + 16, -INT16_MAX);
+			_check_fill(o[0], BENCH_WIDTH * 2 + 16, INT16_MIN);
+			memcpy(o[1], o[0], sizeof(o[0]));
+			
+			vid_cmul_scalar(&o[0][a * 2], &c[a * 2], n);
+			_vid_kernels[k].cmul(&o[1][a * 2], &c[a * 2], n);
+			
+			if(memcmp(o[0], o[1], sizeof(o[0])) != 0) errors++;
+			
+			samples += n;
+		}
+		
+		sprintf(params, "isa=%s", _vid_kernels[k].isa);
+		_check_print("vid_cmul", params, samples, errors);
+	}
+}
+
+static void _check_rf_convert(void)
+{
+	static const char *types[] = { "uint8", "int8", "uint16", "int16", "int32", "float" };
+	const int ids[] = { RF_UINT8, RF_INT8, RF_UINT16, RF_INT16, RF_INT32, RF_FLOAT };
+	const int sizes[] = { 1, 1, 2, 2, 4, 4 };
+	const struct {
+		const char *name;
+		int features;
+	} isas[] = {
+		{ "sse2", CPU_SSE2 },
+		{ "avx2", CPU_SSE2 | CPU_AVX2 },
+		{ "neon", CPU_NEON },
+	};
+	static int16_t in[BENCH_WIDTH * 2 + 16];
+	static uint8_t out[2][(BENCH_WIDTH + 8) * 2 * 4];
+	rf_convert_t ref, fn;
+	uint64_t samples;
+	char name[64];
+	char params[64];
+	int f = cpu_features();
+	int i, j, c, run, n, a, size, errors;
+	
+	for(c = 0; c < 2; c++)
+	{
+		for(i = 0; i < sizeof(ids) / sizeof(int); i++)
+		{
+			sprintf(name, "rf_convert_%s_%s", types[i], c ? "complex" : "real");
+			if(_bench_skip(name)) continue;
+			
+			ref = rf_convert_kernel(ids[i], c, 0);
+			size = sizes[i] * (c ? 2 : 1);
+			
+			for(j = 0; j < sizeof(isas) / sizeof(isas[0]); j++)
+			{
+				if((isas[j].features & f) != isas[j].features) continue;
+				
+				fn = rf_convert_kernel(ids[i], c, isas[j].features);
+				
+				for(samples = 0, errors = 0, run = 0; run <= CHECK_RUNS; run++)
+				{
+					n = _check_len(run);
+					a = run & 7;
+					
+					_check_fill(in, BENCH_WIDTH * 2 + 16, INT16_MIN);
+					_check_fill((int16_t *) out[0], sizeof(out[0]) / sizeof(int16_t), INT16_MIN);
+					memcpy(out[1], out[0], sizeof(out[0]));
+					
+					ref(&out[0][a * size], &in[a * 2], n);
+					fn(&out[1][a * size], &in[a * 2], n);
+					
+					if(memcmp(out[0], out[1], sizeof(out[0])) != 0) errors++;
+					
+					samples += n;
+				}
+				
+				sprintf(params, "isa=%s", isas[j].name);
+				_check_print(name, params, samples, errors);
+			}
+		}
+	}
+}
+
+static void _check_fir_dot(void)
+{
+	static int16_t taps[BENCH_WIDTH + 16];
+	static int16_t in[BENCH_WIDTH * 2 + 16];
+	int32_t r[2][2];
+	uint64_t samples[2];
+	int errors[2];
+	char params[64];
+	int k, run, n, a, b;
+	
+	for(k = 0; _fir_kernels[k].isa != NULL; k++)
+	{
+		if((cpu_features() & _fir_kernels[k].features) == 0) continue;
+		
+		memset(samples, 0, sizeof(samples));
+		memset(errors, 0, sizeof(errors));
+		
+		for(run = 0; run <= CHECK_RUNS; run++)
+		{
+			n = _check_len(run);
+			a = run & 7;
+			b = (run >> 3) & 7;
+			
+			/* The full range, so the accumulators wrap */
+			_check_fill(taps, BENCH_WIDTH + 16, INT16_MIN);
+			_check_fill(in, BENCH_WIDTH * 2 + 16, INT16_MIN);
+			
+			r[0][0] = fir_dot_scalar(&taps[a], &in[b], n);
+			r[1][0] = _fir_kernels[k].dot(&taps[a], &in[b], n);
+			if(r[0][0] != r[1][0]) errors[0]++;
+			samples[0] += n;
+			
+			fir_dot2_scalar(r[0], &taps[a], &in[b], &in[BENCH_WIDTH + a], n);
+			_fir_kernels[k].dot2(r[1], &taps[a], &in[b], &in[BENCH_WIDTH + a], n);
+			if(r[0][0] != r[1][0] || r[0][1] != r[1][1]) errors[1]++;
+			samples[1] += n;
+		}
+		
+		sprintf(params, "isa=%s", _fir_kernels[k].isa);
+		if(!_bench_skip("fir_dot")) _check_print("fir_dot", params, samples[0], errors[0]);
+		if(!_bench_skip("fir_dot2")) _check_print("fir_dot2", params, samples[1], errors[1]);
+	}
+}
+
+static int _check(void)
+{
+	if(!_bench_skip("fir_dot") || !_bench_skip("fir_dot2")) _check_fir_dot();
+	if(!_bench_skip("vid_rgb") || !_bench_skip("vid_nco")) _check_vid_modes();
+	if(!_bench_skip("vid_mix")) _check_vid_mix();
+	if(!_bench_skip("vid_cmul")) _check_vid_cmul();
+	_check_rf_convert();
+	
+	return(_check_failed);
+}
+
+static void _print_usage(void)
+{
+	printf(
+		"\n"
+		"Usage: hacktv-bench [options] [filter]\n"
+		"\n"
+		"  -t, --time <seconds>           Time to run each benchmark for. Default: 0.25\n"
+		"  -s, --samplerate <value>       Set the sample rate in Hz. Default: 16MHz\n"
+		"  -c, --check                    Check that each SIMD kernel supported by this\n"
+		"                                 CPU matches the scalar version, instead of\n"
+		"                                 running the benchmarks.\n"
+		"\n"
+		"  Only the benchmarks or checks with filter in their name are run.\n"
+		"\n"
+	);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "time",       required_argument, 0, 't' },
+		{ "samplerate", required_argument, 0, 's' },
+		{ "check",      no_argument,       0, 'c' },
+		{ 0,            0,                 0,  0  }
+	};
+	int c, i;
+	
+	_conf.seconds = 0.25;
+	_conf.sample_rate = 16000000;
+	_conf.filter = NULL;
+	_conf.check = 0;
+	
+	while((c = getopt_long(argc, argv, "t:s:c", long_options, NULL)) != -1)
+	{
+		switch(c)
+		{
+		case 't': /* -t, --time <seconds> */
+			_conf.seconds = strtod(optarg, NULL);
+			break;
+		
+		case 's': /* -s, --samplerate <value> */
+			_conf.sample_rate = strtol(optarg, NULL, 0);
+			break;
+		
+		case 'c': /* -c, --check */
+			_conf.check = 1;
+			break;
+		
+		default:
+			_print_usage();
+			return(0);
+		}
+	}
+	
+	if(_conf.seconds <= 0 || _conf.sample_rate <= 0)
+	{
+		_print_usage();
+		return(-1);
+	}
+	
+	if(optind < argc)
+	{
+		_conf.filter = argv[optind];
+	}
+	
+	/* Full scale noise for the test input */
+	srand(0);
+	for(i = 0; i < BENCH_WIDTH * 2; i++)
+	{
+		_in[i] = rand();
+	}
+	
+	if(_conf.check)
+	{
+		return(_check());
+	}
+	
+	_bench_fir_int16();
+	_bench_fir_int32();
+	_bench_iir_int16();
+	_bench_limiter();
+	_bench_vbidata();
+	_bench_audio();
+	_bench_rf_file();
+	_bench_rf_convert();
+	_bench_modes();
+	
+	return(0);
+}
+
@@ -0,0 +1,38 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cpu.h"
+
+int cpu_features(void)
+{
+	int f = 0;
+	
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	
+	if(__builtin_cpu_supports("sse2"))   f |= CPU_SSE2;
+	if(__builtin_cpu_supports("sse4.1")) f |= CPU_SSE41;
+	if(__builtin_cpu_supports("avx2"))   f |= CPU_AVX2;
+#elif defined(__ARM_NEON)
+	/* NEON is part of the base instruction set on AArch64,
+	 * and must be enabled at build time on 32-bit ARM */
+	f |= CPU_NEON;
+#endif
+	
+	return(f);
+}
+
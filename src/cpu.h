@@ -0,0 +1,35 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _CPU_H
+#define _CPU_H
+
+/* SIMD instruction sets */
+#define CPU_SSE2  (1 << 0)
+#define CPU_SSE41 (1 << 1)
+#define CPU_AVX2  (1 << 2)
+#define CPU_NEON  (1 << 3)
+
+/* Detect the SIMD instruction sets supported by this CPU.
+ *
+ * Returns a mask of the CPU_* flags above. Only the instruction
+ * sets this build has kernels for are reported.
+*/
+extern int cpu_features(void);
+
+#endif
+
@@ -51,10 +51,6 @@ static const int16_t _50_10_us_b_taps[DANCE_B_50_10_US_NTAPS] = {
 	1, -1, 1, -1, 1, -1, 1, -1, 1, -1
 };
 
-/* RF symbols */
-static const int _step[4] = { 0, 3, 1, 2 };
-static const int _syms[4] = { 0, 1, 3, 2 };
-
 /* Ranges */
 typedef struct {
 	uint16_t mask;
@@ -350,72 +346,38 @@ void dance_encode_frame_b(
 	s->frame++;
 }
 
-static double _hamming(double x)
-{
-	if(x < -1 || x > 1) return(0);
-	return(0.54 - 0.46 * cos((M_PI * (1.0 + x))));
-}
-
-int dance_mod_init(dance_mod_t *s, uint8_t mode, unsigned int sample_rate, unsigned int frequency, double beta, double level)
+static int _symbol(void *arg)
 {
-	double sps;
-	double t;
-	double r;
-	int x, n;
-	
-	memset(s, 0, sizeof(dance_mod_t));
-	
-	/* Samples per symbol */
-	sps = (double) sample_rate / DANCE_SYMBOL_RATE;
-	
-	/* Calculate the number of taps needed to cover 5 symbols, rounded up to odd number */
-	s->ntaps = ((unsigned int) (sps * 5) + 1) | 1;
+	dance_mod_t *s = arg;
+	int sym;
 	
-	s->taps = malloc(sizeof(int16_t) * s->ntaps);
-	if(!s->taps)
+	if(s->frame_bit == DANCE_FRAME_BITS)
 	{
-		return(-1);
+		/* Encode the next frame */
+		dance_encode_frame_a(
+			&s->enc, s->frame,
+			s->audio + 0, 2,
+			s->audio + 1, 2,
+			NULL, 0, NULL, 0
+		);
+		s->frame_bit = 0;
 	}
 	
-	/* Generate the filter taps */
-	n = s->ntaps / 2;
-	for(x = -n; x <= n; x++)
-	{
-		t = ((double) x) / sps;
-		
-		r  = rrc(t, beta, 1.0) * _hamming((double) x / n);
-		r *= M_SQRT1_2 * INT16_MAX * level;
-		
-		s->taps[x + n] = lround(r);
-	}
-	
-	/* Allocate memory for the baseband buffer */
-	s->bb_start = calloc(s->ntaps, sizeof(cint16_t));
-	if(!s->bb_start)
-	{
-		return(-1);
-	}
+	/* Read out the next 2-bit symbol, MSB first */
+	sym = (s->frame[s->frame_bit >> 3] >> (6 - (s->frame_bit & 0x07))) & 0x03;
+	s->frame_bit += 2;
 	
-	s->bb_end   = s->bb_start + s->ntaps;
-	s->bb       = s->bb_start;
-	s->bb_len   = 0;
-	
-	/* Setup values for the sample rate error correction */
-	n = gcd(sample_rate, DANCE_SYMBOL_RATE);
-	
-	s->decimation = DANCE_SYMBOL_RATE / n;
-	s->sps = (sample_rate + DANCE_SYMBOL_RATE - 1) / DANCE_SYMBOL_RATE;
-	s->dsl = (s->sps * s->decimation) % (sample_rate / n);
-	s->ds  = 0;
+	return(sym);
+}
+
+int dance_mod_init(dance_mod_t *s, uint8_t mode, unsigned int sample_rate, unsigned int frequency, double beta, double level)
+{
+	int r;
 	
-	/* Setup the mixer signal */
-	n = gcd(sample_rate, frequency);
-	x = sample_rate / n;
-	s->cc_start = sin_cint16(x, frequency / n, 1.0);
-	s->cc_end   = s->cc_start + x;
-	s->cc       = s->cc_start;
+	memset(s, 0, sizeof(dance_mod_t));
 	
-	if(!s->cc)
+	r = qpsk_mod_init(&s->qpsk, sample_rate, DANCE_SYMBOL_RATE, frequency, beta, level, _symbol, s);
+	if(r != 0)
 	{
 		return(-1);
 	}
@@ -429,9 +391,7 @@ int dance_mod_init(dance_mod_t *s, uint8_t mode, unsigned int sample_rate, unsig
 
 int dance_mod_free(dance_mod_t *s)
 {
-	free(s->cc_start);
-	free(s->bb_start);
-	free(s->taps);
+	qpsk_mod_free(&s->qpsk);
 	
 	return(0);
 }
@@ -443,76 +403,7 @@ void dance_mod_input(dance_mod_t *s, const int16_t *audio)
 
 int dance_mod_output(dance_mod_t *s, int16_t *iq, size_t samples)
 {
-	cint16_t *ciq = (cint16_t *) iq;
-	int x, i;
-	int16_t r;
-	
-	for(x = 0; x < samples;)
-	{
-		/* Output and clear the buffer */
-		for(; x < samples && s->bb_len; x++, s->bb_len--)
-		{
-			cint16_mula(ciq++, s->bb, s->cc);
-			
-			s->bb->i = 0;
-			s->bb->q = 0;
-			
-			if(++s->bb == s->bb_end)
-			{
-				s->bb = s->bb_start;
-			}
-			
-			if(++s->cc == s->cc_end)
-			{
-				s->cc = s->cc_start;
-			}
-		}
-		
-		if(s->bb_len > 0)
-		{
-			break;
-		}
-		
-		if(s->frame_bit == DANCE_FRAME_BITS)
-		{
-			/* Encode the next frame */
-			dance_encode_frame_a(
-				&s->enc, s->frame,
-				s->audio + 0, 2,
-				s->audio + 1, 2,
-				NULL, 0, NULL, 0
-			);
-			s->frame_bit = 0;
-		}
-		
-		/* Read out the next 2-bit symbol, MSB first */
-		s->dsym += _step[(s->frame[s->frame_bit >> 3] >> (6 - (s->frame_bit & 0x07))) & 0x03];
-		s->dsym &= 0x03;
-		s->frame_bit += 2;
-		
-		/* Encode the symbol */
-		for(i = 0; i < s->ntaps; i++)
-		{
-			r = s->taps[i];
-			s->bb->i += (_syms[s->dsym] & 1 ? r : -r);
-			s->bb->q += (_syms[s->dsym] & 2 ? r : -r);
-			
-			if(++s->bb == s->bb_end)
-			{
-				s->bb = s->bb_start;
-			}
-		}
-		
-		/* Calculate length of the next block */
-		s->bb_len = s->sps;
-		
-		s->ds += s->dsl;
-		if(s->ds >= s->decimation)
-		{
-			s->bb_len--;
-			s->ds -= s->decimation;
-		}
-	}
+	qpsk_mod_output(&s->qpsk, iq, samples);
 	
 	return(0);
 }
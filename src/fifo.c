@@ -21,6 +21,9 @@
 #include <pthread.h>
 #include "fifo.h"
 
+/* Alignment of the block data */
+#define FIFO_ALIGN 4096
+
 int fifo_init(fifo_t *fifo, size_t count, size_t length)
 {
 	int i;
@@ -36,8 +39,10 @@ int fifo_init(fifo_t *fifo, size_t count, size_t length)
 		return(-1);
 	}
 	
-	fifo->blocks->data = calloc(length, count);
-	if(!fifo->blocks->data)
+	/* The data is aligned to a page, so blocks with a length
+	 * that is a multiple of the page size are also aligned */
+	fifo->mem = calloc(length * count + FIFO_ALIGN - 1, 1);
+	if(!fifo->mem)
 	{
 		free(fifo->blocks);
 		return(-1);
@@ -49,7 +54,7 @@ int fifo_init(fifo_t *fifo, size_t count, size_t length)
 		pthread_cond_init(&fifo->blocks[i].cond, NULL);
 		fifo->blocks[i].readers = 0;
 		fifo->blocks[i].writing = 1;
-		fifo->blocks[i].data = (uint8_t *) fifo->blocks->data + (length * i);
+		fifo->blocks[i].data = (uint8_t *) (((uintptr_t) fifo->mem + FIFO_ALIGN - 1) & ~(uintptr_t) (FIFO_ALIGN - 1)) + (length * i);
 		fifo->blocks[i].length = length;
 		fifo->blocks[i].prev = &fifo->blocks[(i + count - 1) % count];
 		fifo->blocks[i].next = &fifo->blocks[(i + 1) % count];
@@ -169,7 +174,7 @@ void fifo_free(fifo_t *fifo)
 		pthread_mutex_destroy(&fifo->blocks[i].mutex);
 	}
 	
-	free(fifo->blocks->data);
+	free(fifo->mem);
 	free(fifo->blocks);
 	
 	fifo->block = NULL;
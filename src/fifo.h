@@ -39,6 +39,7 @@ typedef struct {
 	
 	size_t count;
 	fifo_block_t *blocks;
+	void *mem;
 	
 	fifo_block_t *block;
 	size_t offset;
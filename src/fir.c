@@ -20,6 +20,7 @@
 #include <string.h>
 #include <math.h>
 #include "fir.h"
+#include "fir_simd.h"
 #include "common.h"
 
 
@@ -260,6 +261,181 @@ void fir_complex_band_pass(double *taps, size_t ntaps, double sample_rate, doubl
 
 
 
+static int _fir_int16_tap(const fir_int16_t *s, int j)
+{
+	/* Offset of tap j in the padded tap array */
+	return(j / s->ataps * s->ptaps + j % s->ataps);
+}
+
+static void _fir_int16_win_init(fir_int16_t *s, int delay, int channels)
+{
+	/* The window is a linear buffer holding the last lwin samples,
+	 * followed by space for a block of new input. Input is copied
+	 * in a block at a time and the window slides along it, only
+	 * moving back to the start of the buffer when it reaches the
+	 * end. The extra FIR_DOT_ALIGN samples allow the padded taps
+	 * to be applied at any position, they are always multiplied
+	 * by a zero tap */
+	s->lwin = s->ataps + delay;
+	s->swin = s->lwin * 2 + 1024;
+	s->win = calloc(s->swin + FIR_DOT_ALIGN, sizeof(int16_t) * channels);
+	s->owin = s->lwin;
+	s->nwin = s->lwin;
+}
+
+static int _fir_int16_next(fir_int16_t *s, int channels)
+{
+	int16_t *w;
+	int n;
+	
+	/* Step the window forward one input sample, refilling
+	 * the buffer if needed. Returns 0 if out of input */
+	if(s->owin < s->nwin)
+	{
+		s->owin++;
+		return(1);
+	}
+	
+	if(s->in_samples == 0)
+	{
+		return(0);
+	}
+	
+	if(s->nwin == s->swin)
+	{
+		memmove(s->win, &s->win[(s->nwin - s->lwin) * channels], s->lwin * channels * sizeof(int16_t));
+		s->owin = s->nwin = s->lwin;
+	}
+	
+	n = s->swin - s->nwin;
+	if(n > s->in_samples) n = s->in_samples;
+	
+	w = &s->win[s->nwin * channels];
+	s->nwin += n;
+	s->in_samples -= n;
+	
+	if(channels == 2)
+	{
+		for(; n; n--, s->in += s->in_step)
+		{
+			*(w++) = s->in[0];
+			*(w++) = s->in[1];
+		}
+	}
+	else
+	{
+		for(; n; n--, s->in += s->in_step)
+		{
+			*(w++) = *s->in;
+		}
+	}
+	
+	s->owin++;
+	
+	return(1);
+}
+
+/* Resampler with a capped number of phases. A filter for an exact
+ * num / den ratio needs num phases, which for some rate pairs runs
+ * into the thousands. Instead the prototype filter is designed with
+ * FIR_RESAMPLER_PHASES phases, and each output is linearly interpolated
+ * between the two phases either side of its exact position. The extra
+ * phase at the end is the first phase delayed by one input sample. */
+
+#define FIR_RESAMPLER_PHASES 256
+
+static int _fir_int16_interp_init(fir_int16_t *s, const double *taps, int ntaps, int phases, int interpolation, int decimation)
+{
+	int i, k;
+	
+	s->type = 4;
+	
+	/* The phase counter d still steps in units of the exact ratio */
+	s->interpolation = interpolation;
+	s->decimation = decimation;
+	s->phases = phases;
+	s->phase_mul = (UINT64_C(1) << 47) * phases / interpolation;
+	
+	/* One extra tap per phase, as the taps for phase i are
+	 * taken starting one input sample back at i - phases */
+	s->ataps = (ntaps + phases - 1) / phases + 1;
+	s->ntaps = s->ataps * phases;
+	s->ptaps = (s->ataps + FIR_DOT_ALIGN - 1) / FIR_DOT_ALIGN * FIR_DOT_ALIGN;
+	
+	s->itaps = calloc(s->ptaps * (phases + 1), sizeof(int16_t));
+	s->qtaps = NULL;
+	fir_dot_kernels(&s->dot, &s->dot2);
+	
+	if(!s->itaps)
+	{
+		return(-1);
+	}
+	
+	/* Copy taps into the order they will be applied. Position k
+	 * is applied to the input sample ataps - 1 - k before the
+	 * newest. This gives the same delay as fir_int16_init() */
+	for(i = 0; i <= phases; i++)
+	{
+		for(k = 0; k < s->ataps; k++)
+		{
+			int j = i + (s->ataps - 2 - k) * phases;
+			
+			if(j >= 0 && j < ntaps)
+			{
+				s->itaps[i * s->ptaps + k] = lround(taps[j] * 32767.0);
+			}
+		}
+	}
+	
+	_fir_int16_win_init(s, 0, 1);
+	s->d = s->interpolation;
+	s->in_samples = 0;
+	
+	return(s->win ? 0 : -1);
+}
+
+static size_t _fir_int16_interp_process(fir_int16_t *s, int16_t *out, size_t samples, size_t step)
+{
+	int32_t r[2];
+	int64_t a;
+	uint32_t p;
+	int x;
+	const int16_t *win, *taps;
+	
+	for(x = 0; x < samples;)
+	{
+		if(s->d >= s->interpolation)
+		{
+			/* Move on to the next input sample */
+			if(_fir_int16_next(s, 1) == 0) break;
+			
+			s->d -= s->interpolation;
+		}
+		
+		for(; s->d < s->interpolation && x < samples; s->d += s->decimation)
+		{
+			/* Position between phases, with a 15-bit fraction. The
+			 * multiplier is rounded down so this never reaches the
+			 * last phase */
+			p = ((uint64_t) s->d * s->phase_mul) >> 32;
+			
+			win = &s->win[s->owin - s->lwin];
+			taps = &s->itaps[(p >> 15) * s->ptaps];
+			
+			/* Interpolate between the phases either side */
+			s->dot2(r, win, taps, taps + s->ptaps, s->ptaps);
+			a = r[0] + ((((int64_t) r[1] - r[0]) * (p & 0x7FFF)) >> 15);
+			a >>= 15;
+			
+			*out = a < INT16_MIN ? INT16_MIN : (a > INT16_MAX ? INT16_MAX : a);
+			out += step;
+			x++;
+		}
+	}
+	
+	return(x);
+}
+
 int fir_int16_init(fir_int16_t *s, const double *taps, int ntaps, int interpolation, int decimation, int delay)
 {
 	int i, j;
@@ -272,22 +448,22 @@ int fir_int16_init(fir_int16_t *s, const double *taps, int ntaps, int interpolat
 	/* Round number of taps up to a multiple of the interpolation factor */
 	s->ataps = (ntaps + interpolation - 1) / interpolation;
 	s->ntaps = s->ataps * interpolation;
+	s->ptaps = (s->ataps + FIR_DOT_ALIGN - 1) / FIR_DOT_ALIGN * FIR_DOT_ALIGN;
 	
-	s->itaps = calloc(s->ntaps, sizeof(int16_t));
+	s->itaps = calloc(s->ptaps * interpolation, sizeof(int16_t));
 	s->qtaps = NULL;
+	fir_dot_kernels(&s->dot, &s->dot2);
 	
 	/* Copy taps into the order they will be applied */
 	j = s->ntaps - s->ataps;
 	for(i = ntaps - 1; i >= 0; i--)
 	{
-		s->itaps[j] = lround(taps[i] * 32767.0);
+		s->itaps[_fir_int16_tap(s, j)] = lround(taps[i] * 32767.0);
 		j -= s->ataps;
 		if(j < 0) j += s->ntaps + 1;
 	}
 	
-	s->lwin = s->ataps + delay;
-	s->win = calloc(s->ataps * 2 + delay, sizeof(int16_t));
-	s->owin = 0;
+	_fir_int16_win_init(s, delay, 1);
 	s->d = s->interpolation;
 	s->in_samples = 0;
 	
@@ -299,12 +475,15 @@ void fir_int16_feed(fir_int16_t *s, const int16_t *in, size_t samples, size_t st
 	s->in = in;
 	s->in_samples = samples;
 	s->in_step = step;
+	
+	/* Drop any unused input from the previous feed */
+	s->nwin = s->owin;
 }
 
 size_t fir_int16_process(fir_int16_t *s, int16_t *out, size_t samples, size_t step)
 {
 	int a;
-	int x, y;
+	int x;
 	const int16_t *win, *taps;
 	
 	if(s->type == 0) return(0);
@@ -316,35 +495,28 @@ size_t fir_int16_process(fir_int16_t *s, int16_t *out, size_t samples, size_t st
 		samples = SIZE_MAX;
 	}
 	
+	if(s->type == 4)
+	{
+		return(_fir_int16_interp_process(s, out, samples, step));
+	}
+	
 	for(x = 0; x < samples;)
 	{
 		if(s->d >= s->interpolation)
 		{
-			if(s->in_samples == 0) break;
+			/* Move on to the next input sample */
+			if(_fir_int16_next(s, 1) == 0) break;
 			
 			s->d -= s->interpolation;
-			
-			/* Append the next input sample to the round buffer */
-			s->win[s->owin] = *s->in;
-			if(s->owin < s->ataps) s->win[s->owin + s->lwin] = *s->in;
-			if(++s->owin == s->lwin) s->owin = 0;
-			
-			s->in += s->in_step;
-			s->in_samples--;
 		}
 		
 		for(; s->d < s->interpolation && x < samples; s->d += s->decimation)
 		{
-			win = &s->win[s->owin];
-			taps = &s->itaps[s->d * s->ataps];
+			win = &s->win[s->owin - s->lwin];
+			taps = &s->itaps[s->d * s->ptaps];
 			
 			/* Calculate the next output sample */
-			for(a = y = 0; y < s->ataps; y++)
-			{
-				a += *(win++) * *(taps++);
-			}
-			
-			a >>= 15;
+			a = s->dot(win, taps, s->ptaps) >> 15;
 			*out = a < INT16_MIN ? INT16_MIN : (a > INT16_MAX ? INT16_MAX : a);
 			out += step;
 			x++;
@@ -359,16 +531,13 @@ size_t fir_int16_process_block(fir_int16_t *s, int16_t *out, const int16_t *in,
 	int x;
 	
 	/* Pre-fill buffer */
-	memset(s->win, 0, (s->lwin + s->ataps) * sizeof(int16_t));
-	s->owin = 0;
+	memset(s->win, 0, s->lwin * sizeof(int16_t));
+	s->owin = s->nwin = s->lwin;
 	
-	for(s->owin = 0; s->owin < s->ataps / 2; s->owin++, in += step)
-	{
-		s->win[s->owin] = *in;
-		if(s->owin < s->ataps) s->win[s->owin + s->lwin] = *in;
-	}
+	fir_int16_feed(s, in, s->ataps / 2, step);
+	while(_fir_int16_next(s, 1));
 	
-	fir_int16_feed(s, in, samples, step);
+	fir_int16_feed(s, in + s->ataps / 2 * step, samples, step);
 	x = fir_int16_process(s, out, -1, step);
 	
 	return(x);
@@ -392,7 +561,7 @@ void fir_int16_free(fir_int16_t *s)
 /* Initialise int16 FIR filter r64 resampler */
 int fir_int16_resampler_init(fir_int16_t *s, r64_t out_rate, r64_t in_rate)
 {
-	int ntaps;
+	int ntaps, phases;
 	double *taps;
 	r64_t r;
 	int i;
@@ -400,8 +569,11 @@ int fir_int16_resampler_init(fir_int16_t *s, r64_t out_rate, r64_t in_rate)
 	/* Calculate ratio */
 	r = r64_div(out_rate, in_rate);
 	
+	/* Use interpolated phases if the exact filter would be too large */
+	phases = r.num > FIR_RESAMPLER_PHASES ? FIR_RESAMPLER_PHASES : r.num;
+	
 	/* Generate the filter taps */
-	ntaps = (21 * r.num) | 1;
+	ntaps = (21 * phases) | 1;
 	
 	taps = calloc(ntaps, sizeof(double));
 	if(!taps)
@@ -412,16 +584,23 @@ int fir_int16_resampler_init(fir_int16_t *s, r64_t out_rate, r64_t in_rate)
 	if(r.num > r.den)
 	{
 		/* Resampling up */
-		fir_low_pass(taps, ntaps, r.num, 0.45, 0.1, r.num);
+		fir_low_pass(taps, ntaps, phases, 0.45, 0.1, phases);
 	}
 	else
 	{
 		/* Resampling down */
-		fir_low_pass(taps, ntaps, r.num, 0.45 * r.num / r.den, 0.1 * r.num / r.den, r.num);
+		fir_low_pass(taps, ntaps, phases, 0.45 * r.num / r.den, 0.1 * r.num / r.den, phases);
 	}
 	
 	/* Create the FIR filter */
-	i = fir_int16_init(s, taps, ntaps, r.num, r.den, 0);
+	if(phases < r.num)
+	{
+		i = _fir_int16_interp_init(s, taps, ntaps, phases, r.num, r.den);
+	}
+	else
+	{
+		i = fir_int16_init(s, taps, ntaps, r.num, r.den, 0);
+	}
 	free(taps);
 	
 	return(i);
@@ -445,23 +624,31 @@ int fir_int16_complex_init(fir_int16_t *s, const double *taps, int ntaps, int in
 	/* Round number of taps up to a multiple of the interpolation factor */
 	s->ataps = (ntaps + interpolation - 1) / interpolation;
 	s->ntaps = s->ataps * interpolation;
-	
-	s->itaps = calloc(s->ntaps, sizeof(int16_t));
-	s->qtaps = calloc(s->ntaps, sizeof(int16_t));
-	
-	/* Copy the taps in the order and format they are to be used */
+	s->ptaps = (s->ataps + FIR_DOT_ALIGN - 1) / FIR_DOT_ALIGN * FIR_DOT_ALIGN;
+	
+	s->itaps = calloc(s->ptaps * interpolation, sizeof(int16_t) * 2);
+	s->qtaps = calloc(s->ptaps * interpolation, sizeof(int16_t) * 2);
+	fir_dot_kernels(&s->dot, &s->dot2);
+	
+	/* Copy the taps in the order and format they are to be used.
+	 * They are interleaved to match the window, so I and Q are
+	 * each a single dot product:
+	 *
+	 * I = win.i * tap.i - win.q * tap.q, with itaps = { tap.i, -tap.q }
+	 * Q = win.i * tap.q + win.q * tap.i, with qtaps = { tap.q, tap.i }
+	*/
 	j = s->ntaps - s->ataps;
 	for(i = ntaps - 1; i >= 0; i--)
 	{
-		s->itaps[j] = lround(taps[i * 2 + 0] * 32767.0);
-		s->qtaps[j] = lround(taps[i * 2 + 1] * 32767.0);
+		s->itaps[_fir_int16_tap(s, j) * 2 + 0] = lround(taps[i * 2 + 0] * 32767.0);
+		s->itaps[_fir_int16_tap(s, j) * 2 + 1] = -lround(taps[i * 2 + 1] * 32767.0);
+		s->qtaps[_fir_int16_tap(s, j) * 2 + 0] = lround(taps[i * 2 + 1] * 32767.0);
+		s->qtaps[_fir_int16_tap(s, j) * 2 + 1] = lround(taps[i * 2 + 0] * 32767.0);
 		j -= s->ataps;
 		if(j < 0) j += s->ntaps + 1;
 	}
 	
-	s->lwin = s->ataps + delay;
-	s->win = calloc(s->ataps * 2 + delay, sizeof(int16_t) * 2);
-	s->owin = 0;
+	_fir_int16_win_init(s, delay, 2);
 	s->d = s->interpolation;
 	s->in_samples = 0;
 	
@@ -470,8 +657,8 @@ int fir_int16_complex_init(fir_int16_t *s, const double *taps, int ntaps, int in
 
 size_t fir_int16_complex_process(fir_int16_t *s, int16_t *out, size_t samples, size_t step)
 {
-	int32_t ai, aq;
-	int x, y;
+	int32_t a[2];
+	int x;
 	const int16_t *win, *itaps, *qtaps;
 	
 	if(samples <= 0)
@@ -483,41 +670,25 @@ size_t fir_int16_complex_process(fir_int16_t *s, int16_t *out, size_t samples, s
 	{
 		if(s->d >= s->interpolation)
 		{
-			if(s->in_samples == 0) break;
+			/* Move on to the next input sample */
+			if(_fir_int16_next(s, 2) == 0) break;
 			
 			s->d -= s->interpolation;
-			
-			/* Append the next input sample to the round buffer */
-			s->win[s->owin * 2 + 0] = s->in[0];
-			s->win[s->owin * 2 + 1] = s->in[1];
-			if(s->owin < s->ataps)
-			{
-				s->win[(s->owin + s->lwin) * 2 + 0] = s->in[0];
-				s->win[(s->owin + s->lwin) * 2 + 1] = s->in[1];
-			}
-			if(++s->owin == s->lwin) s->owin = 0;
-			
-			s->in += s->in_step;
-			s->in_samples--;
 		}
 		
 		for(; s->d < s->interpolation && x < samples; s->d += s->decimation)
 		{
-			win = &s->win[s->owin * 2];
-			itaps = &s->itaps[s->d * s->ataps];
-			qtaps = &s->qtaps[s->d * s->ataps];
+			win = &s->win[(s->owin - s->lwin) * 2];
+			itaps = &s->itaps[s->d * s->ptaps * 2];
+			qtaps = &s->qtaps[s->d * s->ptaps * 2];
 			
 			/* Calculate the next output sample */
-			for(ai = aq = y = 0; y < s->ataps; y++, win += 2, itaps++, qtaps++)
-			{
-				ai += win[0] * *itaps - win[1] * *qtaps;
-				aq += win[0] * *qtaps + win[1] * *itaps;
-			}
+			s->dot2(a, win, itaps, qtaps, s->ptaps * 2);
 			
-			ai >>= 15;
-			aq >>= 15;
-			out[0] = ai < INT16_MIN ? INT16_MIN : (ai > INT16_MAX ? INT16_MAX : ai);
-			out[1] = aq < INT16_MIN ? INT16_MIN : (aq > INT16_MAX ? INT16_MAX : aq);
+			a[0] >>= 15;
+			a[1] >>= 15;
+			out[0] = a[0] < INT16_MIN ? INT16_MIN : (a[0] > INT16_MAX ? INT16_MAX : a[0]);
+			out[1] = a[1] < INT16_MIN ? INT16_MIN : (a[1] > INT16_MAX ? INT16_MAX : a[1]);
 			out += step;
 			x++;
 		}
@@ -538,23 +709,23 @@ int fir_int16_scomplex_init(fir_int16_t *s, const double *taps, int ntaps, int i
 	/* Round number of taps up to a multiple of the interpolation factor */
 	s->ataps = (ntaps + interpolation - 1) / interpolation;
 	s->ntaps = s->ataps * interpolation;
+	s->ptaps = (s->ataps + FIR_DOT_ALIGN - 1) / FIR_DOT_ALIGN * FIR_DOT_ALIGN;
 	
-	s->itaps = calloc(s->ntaps, sizeof(int16_t));
-	s->qtaps = calloc(s->ntaps, sizeof(int16_t));
+	s->itaps = calloc(s->ptaps * interpolation, sizeof(int16_t));
+	s->qtaps = calloc(s->ptaps * interpolation, sizeof(int16_t));
+	fir_dot_kernels(&s->dot, &s->dot2);
 	
 	/* Copy the taps in the order and format they are to be used */
 	j = s->ntaps - s->ataps;
 	for(i = ntaps - 1; i >= 0; i--)
 	{
-		s->itaps[j] = lround(taps[i * 2 + 0] * 32767.0);
-		s->qtaps[j] = lround(taps[i * 2 + 1] * 32767.0);
+		s->itaps[_fir_int16_tap(s, j)] = lround(taps[i * 2 + 0] * 32767.0);
+		s->qtaps[_fir_int16_tap(s, j)] = lround(taps[i * 2 + 1] * 32767.0);
 		j -= s->ataps;
 		if(j < 0) j += s->ntaps + 1;
 	}
 	
-	s->lwin = s->ataps + delay;
-	s->win = calloc(s->ataps * 2 + delay, sizeof(int16_t));
-	s->owin = 0;
+	_fir_int16_win_init(s, delay, 1);
 	s->d = s->interpolation;
 	s->in_samples = 0;
 	
@@ -563,8 +734,8 @@ int fir_int16_scomplex_init(fir_int16_t *s, const double *taps, int ntaps, int i
 
 size_t fir_int16_scomplex_process(fir_int16_t *s, int16_t *out, size_t samples, size_t step)
 {
-	int32_t ai, aq;
-	int x, y;
+	int32_t a[2];
+	int x;
 	const int16_t *win, *itaps, *qtaps;
 	
 	if(samples <= 0)
@@ -576,36 +747,25 @@ size_t fir_int16_scomplex_process(fir_int16_t *s, int16_t *out, size_t samples,
 	{
 		if(s->d >= s->interpolation)
 		{
-			if(s->in_samples == 0) return(x);
+			/* Move on to the next input sample */
+			if(_fir_int16_next(s, 1) == 0) return(x);
 			
 			s->d -= s->interpolation;
-			
-			/* Append the next input sample to the round buffer */
-			s->win[s->owin] = *s->in;
-			if(s->owin < s->ataps) s->win[s->owin + s->lwin] = *s->in;
-			if(++s->owin == s->lwin) s->owin = 0;
-			
-			s->in += s->in_step;
-			s->in_samples--;
 		}
 		
 		for(; s->d < s->interpolation && x < samples; s->d += s->decimation)
 		{
-			win = &s->win[s->owin];
-			itaps = &s->itaps[s->d * s->ataps];
-			qtaps = &s->qtaps[s->d * s->ataps];
+			win = &s->win[s->owin - s->lwin];
+			itaps = &s->itaps[s->d * s->ptaps];
+			qtaps = &s->qtaps[s->d * s->ptaps];
 			
 			/* Calculate the next output sample */
-			for(ai = aq = y = 0; y < s->ataps; y++)
-			{
-				ai += *win     * *(itaps++);
-				aq += *(win++) * *(qtaps++);
-			}
+			s->dot2(a, win, itaps, qtaps, s->ptaps);
 			
-			ai >>= 15;
-			aq >>= 15;
-			out[0] = ai < INT16_MIN ? INT16_MIN : (ai > INT16_MAX ? INT16_MAX : ai);
-			out[1] = aq < INT16_MIN ? INT16_MIN : (aq > INT16_MAX ? INT16_MAX : aq);
+			a[0] >>= 15;
+			a[1] >>= 15;
+			out[0] = a[0] < INT16_MIN ? INT16_MIN : (a[0] > INT16_MAX ? INT16_MAX : a[0]);
+			out[1] = a[1] < INT16_MIN ? INT16_MIN : (a[1] > INT16_MAX ? INT16_MAX : a[1]);
 			out += step;
 			x++;
 		}
@@ -705,7 +865,8 @@ void fir_int32_free(fir_int32_t *s)
 
 /* IIR filter */
 
-
+/* Number of samples filtered per pass */
+#define IIR_BLOCK 256
 
 int iir_int16_init(iir_int16_t *s, const double *a, const double *b)
 {
@@ -720,15 +881,48 @@ int iir_int16_init(iir_int16_t *s, const double *a, const double *b)
 
 size_t iir_int16_process(iir_int16_t *s, int16_t *out, const int16_t *in, size_t samples, size_t step)
 {
-	size_t i;
-	
-	for(i = 0; i < samples; i++)
+	double y[IIR_BLOCK];
+	double x, iy;
+	int32_t t;
+	size_t i, j, n;
+	
+	/* The filter is run in three passes over each block. The feed
+	 * forward terms have no dependency between samples, leaving only
+	 * a single multiply and subtract in the recursive pass. The order
+	 * of operations is unchanged so the result is identical to
+	 * evaluating each sample in turn */
+	
+	for(i = 0; i < samples; i += n)
 	{
-		s->iy = (double) *in * s->b[0] + s->ix * s->b[1] - s->iy * s->a[1];
-		s->ix = (double) *in;
-		*out = lround(s->iy < INT16_MIN ? INT16_MIN : (s->iy > INT16_MAX ? INT16_MAX : s->iy));
-		in += step;
-		out += step;
+		n = samples - i < IIR_BLOCK ? samples - i : IIR_BLOCK;
+		
+		x = s->ix;
+		for(j = 0; j < n; j++)
+		{
+			y[j] = (double) in[j * step] * s->b[0] + x * s->b[1];
+			x = (double) in[j * step];
+		}
+		s->ix = x;
+		
+		iy = s->iy;
+		for(j = 0; j < n; j++)
+		{
+			iy = y[j] - iy * s->a[1];
+			y[j] = iy;
+		}
+		s->iy = iy;
+		
+		/* Clip and round half away from zero, as lround() */
+		for(j = 0; j < n; j++)
+		{
+			x = y[j] < INT16_MIN ? INT16_MIN : (y[j] > INT16_MAX ? INT16_MAX : y[j]);
+			t = (int32_t) x;
+			x -= t;
+			out[j * step] = t + (x >= 0.5) - (x <= -0.5);
+		}
+		
+		in += n * step;
+		out += n * step;
 	}
 	
 	return(samples);
@@ -743,7 +937,8 @@ void iir_int16_free(iir_int16_t *s)
 
 /* Soft Limiter */
 
-
+/* Number of input samples filtered per block */
+#define LIMITER_BLOCK 256
 
 void limiter_free(limiter_t *s)
 {
@@ -753,6 +948,8 @@ void limiter_free(limiter_t *s)
 	free(s->att);
 	free(s->fix);
 	free(s->var);
+	free(s->peaks);
+	free(s->blk);
 }
 
 int limiter_init(limiter_t *s, int16_t level, int width, const double *vtaps, const double *ftaps, int ntaps)
@@ -803,7 +1000,9 @@ int limiter_init(limiter_t *s, int16_t level, int width, const double *vtaps, co
 	s->att = calloc(sizeof(int16_t), s->width);
 	s->fix = calloc(sizeof(int32_t), s->width);
 	s->var = calloc(sizeof(int32_t), s->width);
-	if(!s->att || !s->fix || !s->var)
+	s->peaks = malloc(sizeof(limiter_peak_t) * s->width);
+	s->blk = malloc(sizeof(int32_t) * 2 * LIMITER_BLOCK);
+	if(!s->att || !s->fix || !s->var || !s->peaks || !s->blk)
 	{
 		limiter_free(s);
 		return(-1);
@@ -811,61 +1010,136 @@ int limiter_init(limiter_t *s, int16_t level, int width, const double *vtaps, co
 	
 	s->p = 0;
 	s->h = s->width / 2;
+	s->q = 0;
+	s->npeaks = 0;
+	s->t = 0;
 	
 	return(0);
 }
 
-void limiter_process(limiter_t *s, int16_t *out, const int16_t *vin, const int16_t *fin, int samples, int step)
+static void _limiter_spread(limiter_t *s, const limiter_peak_t *k, int j0, int j1)
 {
-	int i, j;
-	int32_t a, b;
+	int32_t b;
+	int p;
+	
+	/* Apply shape[j0..j1] of a peak to the attenuation window */
+	p = k->p + j0;
+	if(p >= s->width) p -= s->width;
 	
-	for(i = 0; i < samples; i++)
+	for(; j0 <= j1; j0++)
 	{
-		s->var[s->p] = *vin;
-		s->fix[s->p] = (fin ? *fin : 0);
-		s->att[s->p] = 0;
-		
-		/* Apply input filters */
-		if(s->vfir.type) fir_int32_process(&s->vfir, &s->var[s->p], &s->var[s->p], 1);
-		if(s->ffir.type) fir_int32_process(&s->ffir, &s->fix[s->p], &s->fix[s->p], 1);
-		
-		/* Hard limit the fixed input */
-		if(s->fix[s->p] < -s->level) s->fix[s->p] = -s->level;
-		else if(s->fix[s->p] > s->level) s->fix[s->p] = s->level;
+		b = (k->a * s->shape[j0]) >> 15;
+		if(b > s->att[p]) s->att[p] = b;
+		if(++p == s->width) p = 0;
+	}
+}
+
+void limiter_process(limiter_t *s, int16_t *out, const int16_t *vin, const int16_t *fin, int samples, int step)
+{
+	limiter_peak_t *k;
+	int i, j, l, m, n;
+	int32_t a;
+	
+	/* Each over-level sample attenuates the window around it by the
+	 * limiter shape, and the final attenuation is the maximum of these.
+	 * The shape rises to a peak at its centre (m) and falls after it,
+	 * so a peak is fully covered by an earlier peak with a greater
+	 * attenuation up to that peak's centre, and by a later peak with
+	 * an equal or greater attenuation from its centre on. The pending
+	 * peaks are kept in a monotonic queue so only the uncovered parts
+	 * of each shape are applied. The result is identical to applying
+	 * every shape in full. */
+	
+	m = s->width / 2;
+	
+	for(; samples > 0; samples -= l)
+	{
+		l = samples < LIMITER_BLOCK ? samples : LIMITER_BLOCK;
 		
-		/* The variable signal is the difference between vin and fin */
-		s->var[s->p] -= s->fix[s->p];
+		/* Filter a block of input */
+		for(i = 0; i < l; i++)
+		{
+			s->blk[i * 2 + 0] = *vin;
+			s->blk[i * 2 + 1] = (fin ? *fin : 0);
+			
+			vin += step;
+			if(fin) fin += step;
+		}
 		
-		if(++s->p == s->width) s->p = 0;
-		if(++s->h == s->width) s->h = 0;
+		if(s->vfir.type) fir_int32_process(&s->vfir, &s->blk[0], &s->blk[0], l);
+		if(s->ffir.type) fir_int32_process(&s->ffir, &s->blk[1], &s->blk[1], l);
 		
-		/* Soft limit the variable input */
-		a = abs(s->var[s->h] + s->fix[s->h]);
-		if(a > s->level)
+		for(i = 0; i < l; i++)
 		{
-			a = INT16_MAX - (s->level + abs(s->var[s->h]) - a) * INT16_MAX / abs(s->var[s->h]);
+			s->var[s->p] = s->blk[i * 2 + 0];
+			s->fix[s->p] = s->blk[i * 2 + 1];
+			s->att[s->p] = 0;
+			
+			/* Hard limit the fixed input */
+			if(s->fix[s->p] < -s->level) s->fix[s->p] = -s->level;
+			else if(s->fix[s->p] > s->level) s->fix[s->p] = s->level;
+			
+			/* The variable signal is the difference between vin and fin */
+			s->var[s->p] -= s->fix[s->p];
+			
+			if(++s->p == s->width) s->p = 0;
+			if(++s->h == s->width) s->h = 0;
+			s->t++;
 			
-			for(j = 0; j < s->width; j++)
+			/* Soft limit the variable input */
+			a = abs(s->var[s->h] + s->fix[s->h]);
+			if(a > s->level)
 			{
-				b = (a * s->shape[j]) >> 15;
-				if(b > s->att[s->p]) s->att[s->p] = b;
-				if(++s->p == s->width) s->p = 0;
+				a = INT16_MAX - (s->level + abs(s->var[s->h]) - a) * INT16_MAX / abs(s->var[s->h]);
+				
+				/* Finish the falling edge of any weaker peaks */
+				j = 0;
+				while(s->npeaks > 0)
+				{
+					n = s->q + s->npeaks - 1;
+					k = &s->peaks[n < s->width ? n : n - s->width];
+					
+					if(k->a > a)
+					{
+						/* Skip the rising edge up to the
+						 * centre of the stronger peak */
+						j = m - (s->t - k->t) + 1;
+						break;
+					}
+					
+					_limiter_spread(s, k, m + 1, m + s->t - k->t - 1);
+					s->npeaks--;
+				}
+				
+				/* Add the new peak and apply its rising edge */
+				n = s->q + s->npeaks++;
+				k = &s->peaks[n < s->width ? n : n - s->width];
+				k->a = a;
+				k->t = s->t;
+				k->p = s->p;
+				
+				_limiter_spread(s, k, j, m);
 			}
+			
+			/* The oldest peak's falling edge must be complete
+			 * before the first sample after its centre is output */
+			if(s->npeaks > 0 && s->t - s->peaks[s->q].t == m)
+			{
+				_limiter_spread(s, &s->peaks[s->q], m + 1, s->width - 1);
+				if(++s->q == s->width) s->q = 0;
+				s->npeaks--;
+			}
+			
+			a  = s->fix[s->p];
+			a += ((int64_t) s->var[s->p] * (INT16_MAX - s->att[s->p])) >> 15;
+			
+			/* Hard limit to catch rounding errors */
+			if(a < -s->level) a = -s->level;
+			else if(a > s->level) a = s->level;
+			
+			*out = a;
+			out += step;
 		}
-		
-		a  = s->fix[s->p];
-		a += ((int64_t) s->var[s->p] * (INT16_MAX - s->att[s->p])) >> 15;
-		
-		/* Hard limit to catch rounding errors */
-		if(a < -s->level) a = -s->level;
-		else if(a > s->level) a = s->level;
-		
-		*out = a;
-		
-		vin += step;
-		out += step;
-		if(fin) fin += step;
 	}
 }
 
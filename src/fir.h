@@ -20,6 +20,12 @@
 
 #include "common.h"
 
+/* Dot product of two int16 arrays, summed with 32-bit wrap around */
+typedef int32_t (*fir_int16_dot_t)(const int16_t *a, const int16_t *b, int n);
+
+/* Two dot products sharing the first array, r[0] = a.b0 and r[1] = a.b1 */
+typedef void (*fir_int16_dot2_t)(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n);
+
 typedef struct {
 	
 	int type;
@@ -29,11 +35,16 @@ typedef struct {
 	
 	int ntaps;
 	int ataps;
+	int ptaps;
 	int16_t *itaps;
 	int16_t *qtaps;
+	fir_int16_dot_t dot;
+	fir_int16_dot2_t dot2;
 	
 	int owin;
 	int lwin;
+	int nwin;
+	int swin;
 	int16_t *win;
 	int d;
 	
@@ -41,6 +52,10 @@ typedef struct {
 	size_t in_samples;
 	size_t in_step;
 	
+	/* Interpolated polyphase resampler (type 4) */
+	int phases;
+	uint64_t phase_mul;
+	
 } fir_int16_t;
 
 typedef struct {
@@ -100,6 +115,12 @@ extern int iir_int16_init(iir_int16_t *s, const double *a, const double *b);
 extern size_t iir_int16_process(iir_int16_t *s, int16_t *out, const int16_t *in, size_t samples, size_t step);
 extern void iir_int16_free(iir_int16_t *s);
 
+typedef struct {
+	int16_t a;		/* Peak attenuation */
+	unsigned int t;		/* Sample counter at the peak */
+	int p;			/* Window start in the ring buffers */
+} limiter_peak_t;
+
 typedef struct {
 	
 	/* Input fir filters */
@@ -118,6 +139,15 @@ typedef struct {
 	int p;
 	int h;
 	
+	/* Pending peaks, oldest first with strictly falling attenuation */
+	limiter_peak_t *peaks;
+	int q;
+	int npeaks;
+	unsigned int t;
+	
+	/* Interleaved var/fix input block for the filters */
+	int32_t *blk;
+	
 } limiter_t;
 
 extern void limiter_free(limiter_t *s);
@@ -0,0 +1,240 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Dot product kernels for the int16 FIR filters. The products are
+ * summed into 32-bit accumulators which wrap on overflow, so the
+ * order they are added in makes no difference to the result. All
+ * versions are bit-exact with the plain C loop. */
+
+#include <stdint.h>
+#include "fir_simd.h"
+#include "cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+int32_t fir_dot_scalar(const int16_t *a, const int16_t *b, int n)
+{
+	uint32_t r;
+	int x;
+	
+	for(r = x = 0; x < n; x++)
+	{
+		r += (uint32_t) (a[x] * b[x]);
+	}
+	
+	return((int32_t) r);
+}
+
+void fir_dot2_scalar(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n)
+{
+	uint32_t r0, r1;
+	int x;
+	
+	for(r0 = r1 = x = 0; x < n; x++)
+	{
+		r0 += (uint32_t) (a[x] * b0[x]);
+		r1 += (uint32_t) (a[x] * b1[x]);
+	}
+	
+	r[0] = (int32_t) r0;
+	r[1] = (int32_t) r1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+static inline int32_t _hsum_sse2(__m128i r)
+{
+	r = _mm_add_epi32(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+	r = _mm_add_epi32(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+	return(_mm_cvtsi128_si32(r));
+}
+
+__attribute__((target("sse2")))
+int32_t fir_dot_sse2(const int16_t *a, const int16_t *b, int n)
+{
+	__m128i r = _mm_setzero_si128();
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8)
+	{
+		r = _mm_add_epi32(r, _mm_madd_epi16(
+			_mm_loadu_si128((const __m128i *) &a[x]),
+			_mm_loadu_si128((const __m128i *) &b[x])
+		));
+	}
+	
+	return((int32_t) ((uint32_t) _hsum_sse2(r) + (uint32_t) fir_dot_scalar(&a[x], &b[x], n - x)));
+}
+
+__attribute__((target("sse2")))
+void fir_dot2_sse2(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n)
+{
+	__m128i r0 = _mm_setzero_si128();
+	__m128i r1 = _mm_setzero_si128();
+	__m128i v;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8)
+	{
+		v = _mm_loadu_si128((const __m128i *) &a[x]);
+		r0 = _mm_add_epi32(r0, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i *) &b0[x])));
+		r1 = _mm_add_epi32(r1, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i *) &b1[x])));
+	}
+	
+	fir_dot2_scalar(r, &a[x], &b0[x], &b1[x], n - x);
+	r[0] = (int32_t) ((uint32_t) r[0] + (uint32_t) _hsum_sse2(r0));
+	r[1] = (int32_t) ((uint32_t) r[1] + (uint32_t) _hsum_sse2(r1));
+}
+
+__attribute__((target("avx2")))
+static inline int32_t _hsum_avx2(__m256i r)
+{
+	__m128i h;
+	
+	h = _mm_add_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	
+	return(_mm_cvtsi128_si32(h));
+}
+
+__attribute__((target("avx2")))
+int32_t fir_dot_avx2(const int16_t *a, const int16_t *b, int n)
+{
+	__m256i r = _mm256_setzero_si256();
+	int x;
+	
+	for(x = 0; x + 16 <= n; x += 16)
+	{
+		r = _mm256_add_epi32(r, _mm256_madd_epi16(
+			_mm256_loadu_si256((const __m256i *) &a[x]),
+			_mm256_loadu_si256((const __m256i *) &b[x])
+		));
+	}
+	
+	return((int32_t) ((uint32_t) _hsum_avx2(r) + (uint32_t) fir_dot_scalar(&a[x], &b[x], n - x)));
+}
+
+__attribute__((target("avx2")))
+void fir_dot2_avx2(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n)
+{
+	__m256i r0 = _mm256_setzero_si256();
+	__m256i r1 = _mm256_setzero_si256();
+	__m256i v;
+	int x;
+	
+	for(x = 0; x + 16 <= n; x += 16)
+	{
+		v = _mm256_loadu_si256((const __m256i *) &a[x]);
+		r0 = _mm256_add_epi32(r0, _mm256_madd_epi16(v, _mm256_loadu_si256((const __m256i *) &b0[x])));
+		r1 = _mm256_add_epi32(r1, _mm256_madd_epi16(v, _mm256_loadu_si256((const __m256i *) &b1[x])));
+	}
+	
+	fir_dot2_scalar(r, &a[x], &b0[x], &b1[x], n - x);
+	r[0] = (int32_t) ((uint32_t) r[0] + (uint32_t) _hsum_avx2(r0));
+	r[1] = (int32_t) ((uint32_t) r[1] + (uint32_t) _hsum_avx2(r1));
+}
+
+#endif
+
+#if defined(__ARM_NEON)
+
+static inline uint32_t _hsum_neon(int32x4_t r)
+{
+	return((uint32_t) vgetq_lane_s32(r, 0) + (uint32_t) vgetq_lane_s32(r, 1)
+	     + (uint32_t) vgetq_lane_s32(r, 2) + (uint32_t) vgetq_lane_s32(r, 3));
+}
+
+int32_t fir_dot_neon(const int16_t *a, const int16_t *b, int n)
+{
+	int32x4_t r = vdupq_n_s32(0);
+	int16x8_t va, vb;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8)
+	{
+		va = vld1q_s16(&a[x]);
+		vb = vld1q_s16(&b[x]);
+		r = vmlal_s16(r, vget_low_s16(va), vget_low_s16(vb));
+		r = vmlal_s16(r, vget_high_s16(va), vget_high_s16(vb));
+	}
+	
+	return((int32_t) (_hsum_neon(r) + (uint32_t) fir_dot_scalar(&a[x], &b[x], n - x)));
+}
+
+void fir_dot2_neon(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n)
+{
+	int32x4_t r0 = vdupq_n_s32(0);
+	int32x4_t r1 = vdupq_n_s32(0);
+	int16x8_t va, vb0, vb1;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8)
+	{
+		va = vld1q_s16(&a[x]);
+		vb0 = vld1q_s16(&b0[x]);
+		vb1 = vld1q_s16(&b1[x]);
+		r0 = vmlal_s16(r0, vget_low_s16(va), vget_low_s16(vb0));
+		r0 = vmlal_s16(r0, vget_high_s16(va), vget_high_s16(vb0));
+		r1 = vmlal_s16(r1, vget_low_s16(va), vget_low_s16(vb1));
+		r1 = vmlal_s16(r1, vget_high_s16(va), vget_high_s16(vb1));
+	}
+	
+	fir_dot2_scalar(r, &a[x], &b0[x], &b1[x], n - x);
+	r[0] = (int32_t) ((uint32_t) r[0] + _hsum_neon(r0));
+	r[1] = (int32_t) ((uint32_t) r[1] + _hsum_neon(r1));
+}
+
+#endif
+
+void fir_dot_kernels(fir_int16_dot_t *dot, fir_int16_dot2_t *dot2)
+{
+	int f = cpu_features();
+	
+	*dot = fir_dot_scalar;
+	*dot2 = fir_dot2_scalar;
+	
+#if defined(__x86_64__) || defined(__i386__)
+	if(f & CPU_SSE2)
+	{
+		*dot = fir_dot_sse2;
+		*dot2 = fir_dot2_sse2;
+	}
+	
+	if(f & CPU_AVX2)
+	{
+		*dot = fir_dot_avx2;
+		*dot2 = fir_dot2_avx2;
+	}
+#elif defined(__ARM_NEON)
+	if(f & CPU_NEON)
+	{
+		*dot = fir_dot_neon;
+		*dot2 = fir_dot2_neon;
+	}
+#else
+	(void) f;
+#endif
+}
+
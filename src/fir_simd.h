@@ -0,0 +1,47 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _FIR_SIMD_H
+#define _FIR_SIMD_H
+
+#include <stdint.h>
+#include "fir.h"
+
+/* The taps of each filter phase are padded with zeros to a multiple
+ * of this many samples, so the kernels rarely need a scalar tail */
+#define FIR_DOT_ALIGN 16
+
+extern int32_t fir_dot_scalar(const int16_t *a, const int16_t *b, int n);
+extern void fir_dot2_scalar(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n);
+
+#if defined(__x86_64__) || defined(__i386__)
+extern int32_t fir_dot_sse2(const int16_t *a, const int16_t *b, int n);
+extern void fir_dot2_sse2(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n);
+extern int32_t fir_dot_avx2(const int16_t *a, const int16_t *b, int n);
+extern void fir_dot2_avx2(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n);
+#endif
+
+#if defined(__ARM_NEON)
+extern int32_t fir_dot_neon(const int16_t *a, const int16_t *b, int n);
+extern void fir_dot2_neon(int32_t *r, const int16_t *a, const int16_t *b0, const int16_t *b1, int n);
+#endif
+
+/* Select the fastest dot product kernels supported by the CPU */
+extern void fir_dot_kernels(fir_int16_dot_t *dot, fir_int16_dot2_t *dot2);
+
+#endif
+
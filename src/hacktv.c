@@ -20,6 +20,8 @@
 #include <string.h>
 #include <getopt.h>
 #include <signal.h>
+#include <time.h>
+#include <inttypes.h>
 #include "hacktv.h"
 #include "av.h"
 #include "rf.h"
@@ -109,7 +111,16 @@ static void print_usage(void)
 		"      --secam-field-id           Enable SECAM field identification.\n"
 		"      --secam-field-id-lines <x> Set the number of lines per field used for SECAM field\n"
 		"                                 identification. (1-9, default: 9)\n"
-		"      --json                     Output a JSON array when used with --list-modes.\n"
+		"      --block-lines <n>          Number of lines each stage of the encoder\n"
+		"                                 processes per step. (Default: 1)\n"
+		"      --stats                    Print the time used by each stage of the encoder\n"
+		"                                 once per second.\n"
+		"      --benchmark <seconds>      Run the encoder as fast as possible for the given\n"
+		"                                 time and report the throughput. The output\n"
+		"                                 defaults to null.\n"
+		"      --json                     Output a JSON array when used with --list-modes,\n"
+		"                                 or JSON lines when used with --stats or\n"
+		"                                 --benchmark.\n"
 		"      --version                  Print the version number and exit.\n"
 		"\n"
 		"Input options\n"
@@ -167,6 +178,18 @@ static void print_usage(void)
 		"\n"
 		"  -o, --output file:<filename>   Open a file for output. Use - for stdout.\n"
 		"  -t, --type <type>              Set the file data type.\n"
+		"      --file-buffers <n>         Write the file from a separate thread, through\n"
+		"                                 <n> 1 MiB buffers (min 3). Default: 0 (off)\n"
+		"      --file-direct              Bypass the page cache when writing the file.\n"
+		"                                 (Linux only, requires --file-buffers)\n"
+		"      --file-mmap <MiB>          Write the file through a memory map, moving a\n"
+		"                                 window of this many MiB along the file.\n"
+		"      --file-prealloc <bytes>    Allocate this much space for the file before\n"
+		"                                 writing. It is trimmed to the length written\n"
+		"                                 when closed. (Requires --file-mmap)\n"
+		"      --file-pipe                Write the output in large page aligned blocks,\n"
+		"                                 passed to the pipe without a copy with vmsplice()\n"
+		"                                 when the output is a pipe. (Linux only)\n"
 		"\n"
 		"Supported file types:\n"
 		"\n"
@@ -182,6 +205,17 @@ static void print_usage(void)
 		"\n"
 		"  If no valid output prefix is provided, file: is assumed.\n"
 		"\n"
+		"Null output options\n"
+		"\n"
+		"  -o, --output null              Discard the output. For use with --benchmark.\n"
+		"\n"
+		"Shared memory output options\n"
+		"\n"
+		"  -o, --output shm[:<name>]      Publish the output as int16 samples in a\n"
+		"                                 shared memory ring buffer, /<name>, for other\n"
+		"                                 processes to read. The layout is described in\n"
+		"                                 rf_shm.h. Default name: hacktv\n"
+		"\n"
 		"NOTE: The number of samples per line is rounded to the nearest integer,\n"
 		"which may result in a slight frame rate error.\n"
 		"\n"
@@ -382,6 +416,116 @@ static void _list_modes(int json)
 	if(json) printf("]\n");
 }
 
+/* Benchmark state */
+#define _BENCH_SUB     16
+#define _BENCH_BUCKETS (64 * _BENCH_SUB)
+
+typedef struct {
+	uint64_t start;
+	uint64_t end;
+	uint64_t lines;
+	uint64_t samples;
+	uint64_t max;
+	uint64_t hist[_BENCH_BUCKETS];
+} _bench_t;
+
+static uint64_t _clock_ns(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void _bench_init(_bench_t *b, double seconds)
+{
+	memset(b, 0, sizeof(_bench_t));
+	b->start = _clock_ns();
+	b->end = b->start + (uint64_t) (seconds * 1e9);
+}
+
+static void _bench_add(_bench_t *b, uint64_t ns, int samples)
+{
+	int e, i;
+	
+	/* Line latencies are counted in a log-linear histogram, each
+	 * power of two split into _BENCH_SUB buckets. The error in
+	 * the reported percentiles is no more than 1 / _BENCH_SUB */
+	if(ns < _BENCH_SUB)
+	{
+		i = ns;
+	}
+	else
+	{
+		for(e = 0; (ns >> e) >= _BENCH_SUB * 2; e++);
+		i = (e + 1) * _BENCH_SUB + ((ns >> e) & (_BENCH_SUB - 1));
+	}
+	
+	b->hist[i]++;
+	if(ns > b->max) b->max = ns;
+	
+	b->lines++;
+	b->samples += samples;
+}
+
+static uint64_t _bench_percentile(const _bench_t *b, double p)
+{
+	uint64_t n, c;
+	int i, e;
+	
+	/* Return the upper bound of the bucket holding the percentile */
+	n = (uint64_t) (b->lines * p / 100.0);
+	
+	for(c = 0, i = 0; i < _BENCH_BUCKETS; i++)
+	{
+		c += b->hist[i];
+		if(c > n) break;
+	}
+	
+	if(i < _BENCH_SUB) return(i);
+	
+	e = i / _BENCH_SUB - 1;
+	
+	return(((uint64_t) (_BENCH_SUB + (i % _BENCH_SUB) + 1) << e) - 1);
+}
+
+static void _bench_print(const _bench_t *b, int sample_rate, int json)
+{
+	static const double pct[] = { 50, 90, 99, 99.9 };
+	double t, msps, rtf;
+	int i;
+	
+	t = (double) (_clock_ns() - b->start) / 1e9;
+	msps = b->samples / t / 1e6;
+	rtf = (double) b->samples / sample_rate / t;
+	
+	if(json)
+	{
+		fprintf(stderr, "{\"seconds\":%.3f,\"lines\":%" PRIu64 ",\"samples\":%" PRIu64 ",\"msps\":%.3f,\"realtime\":%.3f,\"line_ns\":{", t, b->lines, b->samples, msps, rtf);
+		
+		for(i = 0; i < sizeof(pct) / sizeof(double); i++)
+		{
+			fprintf(stderr, "\"p%g\":%" PRIu64 ",", pct[i], _bench_percentile(b, pct[i]));
+		}
+		
+		fprintf(stderr, "\"max\":%" PRIu64 "}}\n", b->max);
+	}
+	else
+	{
+		fprintf(stderr, "\nBenchmark: %" PRIu64 " lines, %" PRIu64 " samples in %.3f seconds\n", b->lines, b->samples, t);
+		fprintf(stderr, "Throughput: %.3f MS/s, %.3fx real-time\n", msps, rtf);
+		fprintf(stderr, "Line latency (ns):");
+		
+		for(i = 0; i < sizeof(pct) / sizeof(double); i++)
+		{
+			fprintf(stderr, " p%g %" PRIu64 ",", pct[i], _bench_percentile(b, pct[i]));
+		}
+		
+		fprintf(stderr, " max %" PRIu64 "\n", b->max);
+	}
+}
+
 enum {
 	_OPT_TELETEXT = 1000,
 	_OPT_WSS,
@@ -445,6 +589,14 @@ enum {
 	_OPT_PILLARBOX,
 	_OPT_FL2K_AUDIO,
 	_OPT_THREADS,
+	_OPT_BLOCK_LINES,
+	_OPT_STATS,
+	_OPT_BENCHMARK,
+	_OPT_FILE_BUFFERS,
+	_OPT_FILE_DIRECT,
+	_OPT_FILE_MMAP,
+	_OPT_FILE_PREALLOC,
+	_OPT_FILE_PIPE,
 	_OPT_VERSION,
 };
 
@@ -530,10 +682,19 @@ int main(int argc, char *argv[])
 		{ "fl2k-audio",     required_argument, 0, _OPT_FL2K_AUDIO },
 		{ "showecm",        no_argument,       0, _OPT_SHOW_ECM },
 		{ "threads",        no_argument,       0, _OPT_THREADS },
+		{ "block-lines",    required_argument, 0, _OPT_BLOCK_LINES },
+		{ "stats",          no_argument,       0, _OPT_STATS },
+		{ "benchmark",      required_argument, 0, _OPT_BENCHMARK },
+		{ "file-buffers",   required_argument, 0, _OPT_FILE_BUFFERS },
+		{ "file-direct",    no_argument,       0, _OPT_FILE_DIRECT },
+		{ "file-mmap",      required_argument, 0, _OPT_FILE_MMAP },
+		{ "file-prealloc",  required_argument, 0, _OPT_FILE_PREALLOC },
+		{ "file-pipe",      no_argument,       0, _OPT_FILE_PIPE },
 		{ "version",        no_argument,       0, _OPT_VERSION },
 		{ 0,                0,                 0,  0  }
 	};
 	static hacktv_t s;
+	static _bench_t bench;
 	const vid_configs_t *vid_confs;
 	vid_config_t vid_conf;
 	char *pre, *sub;
@@ -551,7 +712,7 @@ int main(int argc, char *argv[])
 	memset(&s, 0, sizeof(hacktv_t));
 	
 	/* Default configuration */
-	s.output_type = "hackrf";
+	s.output_type = NULL;
 	s.output = NULL;
 	s.mode = "i";
 	s.samplerate = 16000000;
@@ -601,6 +762,14 @@ int main(int argc, char *argv[])
 	s.raw_bb_blanking_level = 0;
 	s.raw_bb_white_level = INT16_MAX;
 	s.fl2k_audio = FL2K_AUDIO_NONE;
+	s.block_lines = 1;
+	s.stats = 0;
+	s.benchmark = 0;
+	s.file_buffers = 0;
+	s.file_direct = 0;
+	s.file_mmap = 0;
+	s.file_prealloc = 0;
+	s.file_pipe = 0;
 	
 	opterr = 0;
 	while((c = getopt_long(argc, argv, "o:m:s:D:G:irvf:al:g:A:t:", long_options, &option_index)) != -1)
@@ -641,6 +810,16 @@ int main(int argc, char *argv[])
 				s.output_type = "fl2k";
 				s.output = sub;
 			}
+			else if(strcmp(pre, "null") == 0)
+			{
+				s.output_type = "null";
+				s.output = sub;
+			}
+			else if(strcmp(pre, "shm") == 0)
+			{
+				s.output_type = "shm";
+				s.output = sub;
+			}
 			else
 			{
 				/* Unrecognised output type, default to file */
@@ -1052,6 +1231,73 @@ int main(int argc, char *argv[])
 			
 			break;
 		
+		case _OPT_BLOCK_LINES: /* --block-lines <n> */
+			s.block_lines = strtol(optarg, NULL, 0);
+			
+			if(s.block_lines < 1)
+			{
+				fprintf(stderr, "Invalid number of block lines.\n");
+				return(-1);
+			}
+			
+			break;
+		
+		case _OPT_STATS: /* --stats */
+			s.stats = 1;
+			break;
+		
+		case _OPT_FILE_BUFFERS: /* --file-buffers <n> */
+			s.file_buffers = strtol(optarg, NULL, 0);
+			
+			if(s.file_buffers < 3)
+			{
+				fprintf(stderr, "Invalid number of file buffers.\n");
+				return(-1);
+			}
+			
+			break;
+		
+		case _OPT_FILE_DIRECT: /* --file-direct */
+			s.file_direct = 1;
+			break;
+		
+		case _OPT_FILE_MMAP: /* --file-mmap <MiB> */
+			s.file_mmap = strtol(optarg, NULL, 0);
+			
+			if(s.file_mmap < 1)
+			{
+				fprintf(stderr, "Invalid memory map window size.\n");
+				return(-1);
+			}
+			
+			break;
+		
+		case _OPT_FILE_PREALLOC: /* --file-prealloc <bytes> */
+			s.file_prealloc = strtoull(optarg, NULL, 0);
+			
+			if(s.file_prealloc == 0)
+			{
+				fprintf(stderr, "Invalid file preallocation size.\n");
+				return(-1);
+			}
+			
+			break;
+		
+		case _OPT_FILE_PIPE: /* --file-pipe */
+			s.file_pipe = 1;
+			break;
+		
+		case _OPT_BENCHMARK: /* --benchmark <seconds> */
+			s.benchmark = strtod(optarg, NULL);
+			
+			if(s.benchmark <= 0)
+			{
+				fprintf(stderr, "Invalid benchmark time.\n");
+				return(-1);
+			}
+			
+			break;
+		
 		case _OPT_VERSION: /* --version */
 			print_version();
 			return(0);
@@ -1068,6 +1314,12 @@ int main(int argc, char *argv[])
 		return(-1);
 	}
 	
+	if(s.output_type == NULL)
+	{
+		/* Benchmarks default to no output */
+		s.output_type = s.benchmark > 0 ? "null" : "hackrf";
+	}
+	
 	if(optind >= argc)
 	{
 		fprintf(stderr, "No input specified.\n");
@@ -1435,6 +1687,8 @@ int main(int argc, char *argv[])
 	vid_conf.raw_bb_white_level = s.raw_bb_white_level;
 	vid_conf.secam_field_id = s.secam_field_id;
 	vid_conf.secam_field_id_lines = s.secam_field_id_lines;
+	vid_conf.block_lines = s.block_lines;
+	vid_conf.stats = s.stats ? (s.json ? VID_STATS_JSON : VID_STATS_TEXT) : VID_STATS_NONE;
 	
 	/* Setup video encoder */
 	r = vid_init(&s.vid, s.samplerate, s.pixelrate, &vid_conf);
@@ -1490,7 +1744,72 @@ int main(int argc, char *argv[])
 	}
 	else if(strcmp(s.output_type, "file") == 0)
 	{
-		if(rf_file_open(&s.rf, s.output, s.file_type, s.vid.conf.output_type == RF_INT16_COMPLEX || s.vid.conf.s_video) != RF_OK)
+		int complex = s.vid.conf.output_type == RF_INT16_COMPLEX || s.vid.conf.s_video;
+		
+		if(s.file_direct && s.file_buffers == 0)
+		{
+			fprintf(stderr, "--file-direct requires --file-buffers.\n");
+			vid_free(&s.vid);
+			return(-1);
+		}
+		
+		if(s.file_mmap > 0 && s.file_buffers > 0)
+		{
+			fprintf(stderr, "--file-mmap cannot be used with --file-buffers.\n");
+			vid_free(&s.vid);
+			return(-1);
+		}
+		
+		if(s.file_pipe && (s.file_mmap > 0 || s.file_buffers > 0))
+		{
+			fprintf(stderr, "--file-pipe cannot be used with --file-mmap or --file-buffers.\n");
+			vid_free(&s.vid);
+			return(-1);
+		}
+		
+		if(s.file_prealloc > 0 && s.file_mmap == 0)
+		{
+			fprintf(stderr, "--file-prealloc requires --file-mmap.\n");
+			vid_free(&s.vid);
+			return(-1);
+		}
+		
+		if(s.file_pipe)
+		{
+			r = rf_file_open_pipe(&s.rf, s.output, s.file_type, complex);
+		}
+		else if(s.file_mmap > 0)
+		{
+			r = rf_file_open_mmap(&s.rf, s.output, s.file_type, complex, (size_t) s.file_mmap << 20, s.file_prealloc);
+		}
+		else if(s.file_buffers > 0)
+		{
+			r = rf_file_open_async(&s.rf, s.output, s.file_type, complex, s.file_buffers, s.file_direct);
+		}
+		else
+		{
+			r = rf_file_open(&s.rf, s.output, s.file_type, complex);
+		}
+		
+		if(r != RF_OK)
+		{
+			vid_free(&s.vid);
+			return(-1);
+		}
+	}
+	else if(strcmp(s.output_type, "null") == 0)
+	{
+		if(rf_null_open(&s.rf) != RF_OK)
+		{
+			vid_free(&s.vid);
+			return(-1);
+		}
+	}
+	else if(strcmp(s.output_type, "shm") == 0)
+	{
+		int complex = s.vid.conf.output_type == RF_INT16_COMPLEX || s.vid.conf.s_video;
+		
+		if(rf_shm_open(&s.rf, s.output, &s.vid, complex) != RF_OK)
 		{
 			vid_free(&s.vid);
 			return(-1);
@@ -1525,6 +1844,11 @@ int main(int argc, char *argv[])
 		s.vid.av.height = s.vid.active_width;
 	}
 	
+	if(s.benchmark > 0)
+	{
+		_bench_init(&bench, s.benchmark);
+	}
+	
 	do
 	{
 		if(s.shuffle)
@@ -1578,12 +1902,23 @@ int main(int argc, char *argv[])
 			
 			while(!_abort)
 			{
+				uint64_t t = s.benchmark > 0 ? _clock_ns() : 0;
 				vid_line_t *line = vid_next_line(&s.vid);
 				
 				if(line == NULL) break;
 				
 				if(rf_write(&s.rf, line->output, line->width) != RF_OK) break;
 				if(line->audio_len && rf_write_audio(&s.rf, line->audio, line->audio_len) != RF_OK) break;
+				
+				if(s.benchmark > 0)
+				{
+					uint64_t now = _clock_ns();
+					
+					_bench_add(&bench, now - t, line->width);
+					
+					/* Stop when the benchmark time has elapsed */
+					if(now >= bench.end) _abort = 1;
+				}
 			}
 			
 			if(_signal)
@@ -1592,11 +1927,21 @@ int main(int argc, char *argv[])
 				_signal = 0;
 			}
 			
-			av_close(&s.vid.av);
+			/* When stopping, the source is only aborted
+			 * here, releasing any encoder thread waiting
+			 * on it. vid_free() closes it once the
+			 * threads have ended */
+			if(_abort) av_abort(&s.vid.av);
+			else av_close(&s.vid.av);
 		}
 	}
 	while(s.repeat && !_abort);
 	
+	if(s.benchmark > 0)
+	{
+		_bench_print(&bench, s.vid.sample_rate, s.json);
+	}
+	
 	rf_close(&s.rf);
 	vid_free(&s.vid);
 	
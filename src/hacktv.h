@@ -101,6 +101,14 @@ typedef struct {
 	char *ffmt;
 	char *fopts;
 	int fl2k_audio;
+	int block_lines;
+	int stats;
+	double benchmark;
+	int file_buffers;
+	int file_direct;
+	int file_mmap;
+	uint64_t file_prealloc;
+	int file_pipe;
 	
 	/* Video encoder state */
 	vid_t vid;
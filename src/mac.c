@@ -1798,17 +1798,17 @@ int mac_next_line(vid_t *s, void *arg, int nlines, vid_line_t **lines)
 		
 		for(x = s->active_left; x < s->active_left + s->vframe_x; x++)
 		{
-			l->output[x * 2] = s->yuv_level_lookup[0x000000].y;
+			l->output[x * 2] = vid_rgb_to_yuv(s, 0x000000).y;
 		}
 		
 		for(; x < s->active_left + s->vframe_x + s->vframe.width; x++, px += stride)
 		{
-			l->output[x * 2] = s->yuv_level_lookup[*px & 0xFFFFFF].y;
+			l->output[x * 2] = vid_rgb_to_yuv(s, *px).y;
 		}
 		
 		for(; x < s->active_left + s->active_width; x++)
 		{
-			l->output[x * 2] = s->yuv_level_lookup[0x000000].y;
+			l->output[x * 2] = vid_rgb_to_yuv(s, 0x000000).y;
 		}
 	}
 	
@@ -1829,7 +1829,7 @@ int mac_next_line(vid_t *s, void *arg, int nlines, vid_line_t **lines)
 		
 		for(x = s->mac.chrominance_left + s->vframe_x / 2; x < s->mac.chrominance_left + (s->vframe_x + s->vframe.width) / 2; x++, px += stride)
 		{
-			l->output[x * 2] += (l->line & 1 ? s->yuv_level_lookup[*px & 0xFFFFFF].u : s->yuv_level_lookup[*px & 0xFFFFFF].v);
+			l->output[x * 2] += (l->line & 1 ? vid_rgb_to_yuv(s, *px).u : vid_rgb_to_yuv(s, *px).v);
 		}
 	}
 	
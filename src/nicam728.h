@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include "common.h"
+#include "qpsk.h"
 
 /* NICAM bit and symbol rates */
 #define NICAM_BIT_RATE    728000
@@ -69,25 +70,7 @@ typedef struct {
 	
 	int16_t audio[NICAM_AUDIO_LEN * 2];
 	
-	int ntaps;
-	int16_t *taps;
-	int16_t *hist;
-	
-	int dsym; /* Differential symbol */
-	
-	cint16_t *bb;
-	cint16_t *bb_start;
-	cint16_t *bb_end;
-	int bb_len;
-	
-	int sps;
-	int ds;
-	int dsl;
-	int decimation;
-	
-	cint16_t *cc;
-	cint16_t *cc_start;
-	cint16_t *cc_end;
+	qpsk_mod_t qpsk;
 	
 	uint8_t frame[NICAM_FRAME_BYTES];
 	int frame_bit;
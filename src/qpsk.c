@@ -0,0 +1,226 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Differential QPSK modulator shared by NICAM and DANCE
+ * 
+ * Symbols are shaped by a root raised cosine filter and mixed onto
+ * the carrier. The baseband and carrier are kept as separate I and Q
+ * arrays so the pulse and mixer loops can be vectorised.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "qpsk.h"
+#include "common.h"
+
+static const int _step[4] = { 0, 3, 1, 2 };
+static const int _syms[4] = { 0, 1, 3, 2 };
+
+static double _hamming(double x)
+{
+	if(x < -1 || x > 1) return(0);
+	return(0.54 - 0.46 * cos((M_PI * (1.0 + x))));
+}
+
+int qpsk_mod_init(qpsk_mod_t *s, unsigned int sample_rate, unsigned int symbol_rate, unsigned int frequency, double beta, double level, qpsk_symbol_t symbol, void *arg)
+{
+	cint16_t *cc;
+	double sps;
+	double t;
+	double r;
+	int x, n;
+	
+	memset(s, 0, sizeof(qpsk_mod_t));
+	
+	s->symbol = symbol;
+	s->arg = arg;
+	
+	/* Samples per symbol */
+	sps = (double) sample_rate / symbol_rate;
+	
+	/* Calculate the number of taps needed to cover 5 symbols, rounded up to odd number */
+	s->ntaps = ((unsigned int) (sps * 5) + 1) | 1;
+	
+	s->pulse[0] = malloc(sizeof(int16_t) * s->ntaps);
+	s->pulse[1] = malloc(sizeof(int16_t) * s->ntaps);
+	if(!s->pulse[0] || !s->pulse[1])
+	{
+		qpsk_mod_free(s);
+		return(-1);
+	}
+	
+	/* Generate the filter taps */
+	n = s->ntaps / 2;
+	for(x = -n; x <= n; x++)
+	{
+		t = ((double) x) / sps;
+		
+		r  = rrc(t, beta, 1.0) * _hamming((double) x / n);
+		r *= M_SQRT1_2 * INT16_MAX * level;
+		
+		s->pulse[1][x + n] = lround(r);
+		s->pulse[0][x + n] = -s->pulse[1][x + n];
+	}
+	
+	/* Allocate memory for the baseband buffer */
+	s->bb_i = calloc(s->ntaps, sizeof(int16_t));
+	s->bb_q = calloc(s->ntaps, sizeof(int16_t));
+	if(!s->bb_i || !s->bb_q)
+	{
+		qpsk_mod_free(s);
+		return(-1);
+	}
+	
+	s->bb     = 0;
+	s->bb_len = 0;
+	
+	/* Setup values for the sample rate error correction */
+	n = gcd(sample_rate, symbol_rate);
+	
+	s->decimation = symbol_rate / n;
+	s->sps = (sample_rate + symbol_rate - 1) / symbol_rate;
+	s->dsl = (s->sps * s->decimation) % (sample_rate / n);
+	s->ds  = 0;
+	
+	/* Setup the mixer signal */
+	n = gcd(sample_rate, frequency);
+	s->cc_len = sample_rate / n;
+	s->cc     = 0;
+	
+	cc = sin_cint16(s->cc_len, frequency / n, 1.0);
+	s->cc_i = malloc(sizeof(int16_t) * s->cc_len);
+	s->cc_q = malloc(sizeof(int16_t) * s->cc_len);
+	if(!cc || !s->cc_i || !s->cc_q)
+	{
+		free(cc);
+		qpsk_mod_free(s);
+		return(-1);
+	}
+	
+	for(x = 0; x < s->cc_len; x++)
+	{
+		s->cc_i[x] = cc[x].i;
+		s->cc_q[x] = cc[x].q;
+	}
+	
+	free(cc);
+	
+	return(0);
+}
+
+static void _add_pulse(int16_t *dst, const int16_t *src, int n)
+{
+	int x;
+	
+	for(x = 0; x < n; x++)
+	{
+		dst[x] += src[x];
+	}
+}
+
+static void _mix(int16_t *iq, const int16_t *bi, const int16_t *bq, const int16_t *ci, const int16_t *cq, int n)
+{
+	int32_t i, q;
+	int x;
+	
+	/* Mix the baseband onto the carrier, adding to the output */
+	for(x = 0; x < n; x++)
+	{
+		i = (int32_t) bi[x] * (int32_t) ci[x] - (int32_t) bq[x] * (int32_t) cq[x];
+		q = (int32_t) bi[x] * (int32_t) cq[x] + (int32_t) bq[x] * (int32_t) ci[x];
+		
+		iq[x * 2 + 0] += i >> 15;
+		iq[x * 2 + 1] += q >> 15;
+	}
+}
+
+void qpsk_mod_output(qpsk_mod_t *s, int16_t *iq, size_t samples)
+{
+	const int16_t *pi, *pq;
+	int n;
+	
+	while(samples > 0)
+	{
+		/* Output and clear the buffer, in runs that
+		 * stop at the end of either ring buffer */
+		while(samples > 0 && s->bb_len)
+		{
+			n = samples < s->bb_len ? samples : s->bb_len;
+			if(n > s->ntaps - s->bb) n = s->ntaps - s->bb;
+			if(n > s->cc_len - s->cc) n = s->cc_len - s->cc;
+			
+			_mix(iq, &s->bb_i[s->bb], &s->bb_q[s->bb], &s->cc_i[s->cc], &s->cc_q[s->cc], n);
+			
+			memset(&s->bb_i[s->bb], 0, sizeof(int16_t) * n);
+			memset(&s->bb_q[s->bb], 0, sizeof(int16_t) * n);
+			
+			iq += n * 2;
+			samples -= n;
+			s->bb_len -= n;
+			
+			s->bb += n;
+			if(s->bb == s->ntaps) s->bb = 0;
+			
+			s->cc += n;
+			if(s->cc == s->cc_len) s->cc = 0;
+		}
+		
+		if(s->bb_len > 0)
+		{
+			break;
+		}
+		
+		/* Fetch the next symbol */
+		s->dsym += _step[s->symbol(s->arg) & 0x03];
+		s->dsym &= 0x03;
+		
+		/* Add its pulse to the ring buffer. The ring is the
+		 * length of the pulse, so bb is left where it started */
+		pi = s->pulse[_syms[s->dsym] & 1 ? 1 : 0];
+		pq = s->pulse[_syms[s->dsym] & 2 ? 1 : 0];
+		n = s->ntaps - s->bb;
+		
+		_add_pulse(&s->bb_i[s->bb], pi, n);
+		_add_pulse(&s->bb_q[s->bb], pq, n);
+		_add_pulse(s->bb_i, pi + n, s->ntaps - n);
+		_add_pulse(s->bb_q, pq + n, s->ntaps - n);
+		
+		/* Calculate length of the next block */
+		s->bb_len = s->sps;
+		
+		s->ds += s->dsl;
+		if(s->ds >= s->decimation)
+		{
+			s->bb_len--;
+			s->ds -= s->decimation;
+		}
+	}
+}
+
+void qpsk_mod_free(qpsk_mod_t *s)
+{
+	free(s->pulse[0]);
+	free(s->pulse[1]);
+	free(s->bb_i);
+	free(s->bb_q);
+	free(s->cc_i);
+	free(s->cc_q);
+	memset(s, 0, sizeof(qpsk_mod_t));
+}
+
@@ -0,0 +1,64 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _QPSK_H
+#define _QPSK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Returns the next 2-bit symbol to transmit */
+typedef int (*qpsk_symbol_t)(void *arg);
+
+typedef struct {
+	
+	/* Source of symbols */
+	qpsk_symbol_t symbol;
+	void *arg;
+	
+	int dsym; /* Differential symbol */
+	
+	/* Shaped pulse, and its negative */
+	int ntaps;
+	int16_t *pulse[2];
+	
+	/* Baseband ring buffer, the length of the pulse */
+	int16_t *bb_i;
+	int16_t *bb_q;
+	int bb;
+	int bb_len;
+	
+	/* Sample rate error correction */
+	int sps;
+	int ds;
+	int dsl;
+	int decimation;
+	
+	/* Carrier */
+	int16_t *cc_i;
+	int16_t *cc_q;
+	int cc;
+	int cc_len;
+	
+} qpsk_mod_t;
+
+extern int qpsk_mod_init(qpsk_mod_t *s, unsigned int sample_rate, unsigned int symbol_rate, unsigned int frequency, double beta, double level, qpsk_symbol_t symbol, void *arg);
+extern void qpsk_mod_output(qpsk_mod_t *s, int16_t *iq, size_t samples);
+extern void qpsk_mod_free(qpsk_mod_t *s);
+
+#endif
+
@@ -54,6 +54,8 @@ extern int rf_write_audio(rf_t *s, const int16_t *audio, size_t samples);
 extern int rf_close(rf_t *s);
 
 #include "rf_file.h"
+#include "rf_null.h"
+#include "rf_shm.h"
 #include "rf_hackrf.h"
 #include "rf_soapysdr.h"
 #include "rf_fl2k.h"
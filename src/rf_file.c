@@ -15,11 +15,39 @@
 /* You should have received a copy of the GNU General Public License     */
 /* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+/* For O_DIRECT and vmsplice() */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
 #include "rf.h"
+#include "fifo.h"
+#include "rf_simd.h"
+#include "cpu.h"
+
+/* Length of each block passed to the writer thread */
+#define RF_FILE_BLOCK_LEN (1024 * 1024)
+
+/* Writes with O_DIRECT must be a multiple of this length */
+#define RF_FILE_DIRECT_ALIGN 4096
+
+/* Minimum length of each of the two pipe output buffers */
+#define RF_FILE_PIPE_LEN (1024 * 1024)
+
+/* Alignment of the pipe output buffers, so vmsplice() passes whole pages */
+#define RF_FILE_PIPE_ALIGN 4096
 
 /* File sink */
 typedef struct {
@@ -29,256 +57,315 @@ typedef struct {
 	size_t samples;
 	int complex;
 	int type;
+	rf_convert_t convert;
+	
+	/* Asynchronous writer */
+	int async;
+	int direct;
+	fifo_t fifo;
+	fifo_reader_t reader;
+	pthread_t thread;
+	volatile int error;
+	uint64_t blocked_ns;
+	
+	/* Memory mapped output */
+	int mapped;
+	uint8_t *map;
+	size_t map_len;
+	size_t map_pos;
+	off_t map_offset;
+	off_t file_len;
+	
+	/* Pipe output */
+	int piped;
+	int splice;
+	void *pipe_mem;
+	uint8_t *pipe_buf;
+	size_t pipe_len;
+	size_t pipe_pos;
+	int pipe_idx;
 } rf_file_t;
 
-static int _rf_file_write_uint8_real(void *private, const int16_t *iq_data, size_t samples)
+static uint64_t _clock_ns(void)
 {
-	rf_file_t *rf = private;
-	uint8_t *u8 = rf->data;
-	int i;
+	struct timespec ts;
 	
-	while(samples)
-	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			u8[i] = (iq_data[0] - INT16_MIN) >> 8;
-		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
-	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 	
-	return(RF_OK);
+	return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
 }
 
-static int _rf_file_write_int8_real(void *private, const int16_t *iq_data, size_t samples)
+static int _rf_file_write_block(rf_file_t *rf, const void *data, size_t length)
 {
-	rf_file_t *rf = private;
-	int8_t *i8 = rf->data;
-	int i;
-	
-	while(samples)
+#ifdef O_DIRECT
+	if(rf->direct && (length & (RF_FILE_DIRECT_ALIGN - 1)) != 0)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			i8[i] = iq_data[0] >> 8;
-		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
+		/* Only the final block can be a partial one. Drop
+		 * O_DIRECT so it can be written at any length */
+		int fd = fileno(rf->f);
 		
-		samples -= i;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		rf->direct = 0;
 	}
+#endif
 	
-	return(RF_OK);
+	return(fwrite(data, 1, length, rf->f) == length ? RF_OK : RF_ERROR);
 }
 
-static int _rf_file_write_uint16_real(void *private, const int16_t *iq_data, size_t samples)
+static void *_rf_file_writer(void *arg)
 {
-	rf_file_t *rf = private;
-	uint16_t *u16 = rf->data;
-	int i;
+	rf_file_t *rf = arg;
+	void *data;
+	size_t length;
 	
-	while(samples)
+	while((length = fifo_read(&rf->reader, &data, RF_FILE_BLOCK_LEN, 1)) != (size_t) -1)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
+		/* After an error the blocks are still read and
+		 * discarded, so the encoder is never left waiting */
+		if(rf->error) continue;
+		
+		if(_rf_file_write_block(rf, data, length) != RF_OK)
 		{
-			u16[i] = (iq_data[0] - INT16_MIN);
+			perror("fwrite");
+			rf->error = 1;
 		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
 	}
 	
-	return(RF_OK);
+	return(NULL);
 }
 
-static int _rf_file_write_int16_real(void *private, const int16_t *iq_data, size_t samples)
+#ifndef _WIN32
+static int _rf_file_map(rf_file_t *rf, off_t offset)
 {
-	rf_file_t *rf = private;
-	int16_t *i16 = rf->data;
-	int i;
+	void *map;
+	int r;
 	
-	while(samples)
+	if(rf->map)
+	{
+		munmap(rf->map, rf->map_len);
+		rf->map = NULL;
+	}
+	
+	/* Allocate the space for the window before it is mapped,
+	 * so a full disk is reported here rather than by SIGBUS */
+	if(offset + (off_t) rf->map_len > rf->file_len)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
+		r = posix_fallocate(fileno(rf->f), rf->file_len, offset + rf->map_len - rf->file_len);
+		if(r != 0)
 		{
-			i16[i] = iq_data[0];
+			fprintf(stderr, "posix_fallocate: %s\n", strerror(r));
+			return(RF_ERROR);
 		}
 		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
+		rf->file_len = offset + rf->map_len;
+	}
+	
+	map = mmap(NULL, rf->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(rf->f), offset);
+	if(map == MAP_FAILED)
+	{
+		perror("mmap");
+		return(RF_ERROR);
 	}
 	
+	madvise(map, rf->map_len, MADV_SEQUENTIAL);
+	
+	rf->map = map;
+	rf->map_offset = offset;
+	rf->map_pos = 0;
+	
 	return(RF_OK);
 }
+#endif
 
-static int _rf_file_write_int32_real(void *private, const int16_t *iq_data, size_t samples)
+static int _rf_file_pipe_flush(rf_file_t *rf)
 {
-	rf_file_t *rf = private;
-	int32_t *i32 = rf->data;
-	int i;
+	uint8_t *data = rf->pipe_buf + rf->pipe_idx * rf->pipe_len;
+	size_t length = rf->pipe_pos;
+	ssize_t r;
 	
-	while(samples)
+	while(length > 0)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
+#ifdef SPLICE_F_MOVE
+		if(rf->splice)
+		{
+			struct iovec iov = { data, length };
+			
+			/* The pipe references these pages until they are read */
+			r = vmsplice(fileno(rf->f), &iov, 1, 0);
+		}
+		else
+#endif
 		{
-			i32[i] = (iq_data[0] << 16) + iq_data[0];
+			r = write(fileno(rf->f), data, length);
 		}
 		
-		fwrite(rf->data, rf->data_size, i, rf->f);
+		if(r < 0)
+		{
+			if(errno == EINTR) continue;
+			perror(rf->splice ? "vmsplice" : "write");
+			return(RF_ERROR);
+		}
 		
-		samples -= i;
+		data += r;
+		length -= r;
 	}
 	
+	/* Fill the other buffer next. Once this buffer has been spliced
+	 * in full, the pipe can no longer hold any of the other one */
+	rf->pipe_idx ^= 1;
+	rf->pipe_pos = 0;
+	
 	return(RF_OK);
 }
 
-static int _rf_file_write_float_real(void *private, const int16_t *iq_data, size_t samples)
+static size_t _rf_file_buffer(rf_file_t *rf, void **data)
 {
-	rf_file_t *rf = private;
-	float *f32 = rf->data;
-	int i;
+	size_t length;
+	uint64_t t;
 	
-	while(samples)
+	/* Return a buffer for the next converted samples,
+	 * and the number of samples it can hold */
+	
+	if(rf->piped)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			f32[i] = (float) iq_data[0] * (1.0 / 32767.0);
-		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
+		if(rf->error) return(0);
 		
-		samples -= i;
+		*data = rf->pipe_buf + rf->pipe_idx * rf->pipe_len + rf->pipe_pos;
+		return((rf->pipe_len - rf->pipe_pos) / rf->data_size);
 	}
 	
-	return(RF_OK);
-}
-
-static int _rf_file_write_uint8_complex(void *private, const int16_t *iq_data, size_t samples)
-{
-	rf_file_t *rf = private;
-	uint8_t *u8 = rf->data;
-	int i;
-	
-	while(samples)
+#ifndef _WIN32
+	if(rf->mapped)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
+		/* Move on to the next window once this one is full */
+		if(rf->map_pos == rf->map_len &&
+		   _rf_file_map(rf, rf->map_offset + rf->map_len) != RF_OK)
 		{
-			u8[i * 2 + 0] = (iq_data[0] - INT16_MIN) >> 8;
-			u8[i * 2 + 1] = (iq_data[1] - INT16_MIN) >> 8;
+			return(0);
 		}
 		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
+		*data = rf->map + rf->map_pos;
+		return((rf->map_len - rf->map_pos) / rf->data_size);
 	}
+#endif
 	
-	return(RF_OK);
-}
-
-static int _rf_file_write_int8_complex(void *private, const int16_t *iq_data, size_t samples)
-{
-	rf_file_t *rf = private;
-	int8_t *i8 = rf->data;
-	int i;
+	if(!rf->async)
+	{
+		*data = rf->data;
+		return(rf->samples);
+	}
 	
-	while(samples)
+	length = fifo_write_ptr(&rf->fifo, data, 0);
+	
+	if(length == 0)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			i8[i * 2 + 0] = iq_data[0] >> 8;
-			i8[i * 2 + 1] = iq_data[1] >> 8;
-		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
+		/* All the blocks are full, wait for the writer */
+		t = _clock_ns();
+		length = fifo_write_ptr(&rf->fifo, data, 1);
+		rf->blocked_ns += _clock_ns() - t;
 	}
 	
-	return(RF_OK);
+	if(length == (size_t) -1 || rf->error)
+	{
+		return(0);
+	}
+	
+	return(length / rf->data_size);
 }
 
-static int _rf_file_write_uint16_complex(void *private, const int16_t *iq_data, size_t samples)
+static void _rf_file_commit(rf_file_t *rf, size_t samples)
 {
-	rf_file_t *rf = private;
-	uint16_t *u16 = rf->data;
-	int i;
-	
-	while(samples)
+	if(rf->piped)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
+		rf->pipe_pos += samples * rf->data_size;
+		
+		if(rf->pipe_pos == rf->pipe_len && _rf_file_pipe_flush(rf) != RF_OK)
 		{
-			u16[i * 2 + 0] = (iq_data[0] - INT16_MIN);
-			u16[i * 2 + 1] = (iq_data[1] - INT16_MIN);
+			rf->error = 1;
 		}
 		
-		fwrite(rf->data, rf->data_size, i, rf->f);
-		
-		samples -= i;
+		return;
 	}
 	
-	return(RF_OK);
-}
-
-static int _rf_file_write_int16_complex(void *private, const int16_t *iq_data, size_t samples)
-{
-	rf_file_t *rf = private;
+	if(rf->mapped)
+	{
+		rf->map_pos += samples * rf->data_size;
+		return;
+	}
 	
-	fwrite(iq_data, sizeof(int16_t) * 2, samples, rf->f);
+	if(!rf->async)
+	{
+		fwrite(rf->data, rf->data_size, samples, rf->f);
+		return;
+	}
 	
-	return(RF_OK);
+	fifo_write(&rf->fifo, samples * rf->data_size);
 }
 
-static int _rf_file_write_int32_complex(void *private, const int16_t *iq_data, size_t samples)
+static int _rf_file_write(void *private, const int16_t *iq_data, size_t samples)
 {
 	rf_file_t *rf = private;
-	int32_t *i32 = rf->data;
-	int i;
+	void *data;
+	size_t n;
+	
+	if(!rf->async && !rf->mapped && !rf->piped && rf->type == RF_INT16 && rf->complex)
+	{
+		/* No conversion needed */
+		fwrite(iq_data, sizeof(int16_t) * 2, samples, rf->f);
+		return(RF_OK);
+	}
 	
 	while(samples)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			i32[i * 2 + 0] = (iq_data[0] << 16) + iq_data[0];
-			i32[i * 2 + 1] = (iq_data[1] << 16) + iq_data[1];
-		}
+		n = _rf_file_buffer(rf, &data);
+		if(n == 0) return(RF_ERROR);
 		
-		fwrite(rf->data, rf->data_size, i, rf->f);
+		if(n > samples) n = samples;
+		rf->convert(data, iq_data, n);
 		
-		samples -= i;
+		_rf_file_commit(rf, n);
+		
+		iq_data += n * 2;
+		samples -= n;
 	}
 	
 	return(RF_OK);
 }
 
-static int _rf_file_write_float_complex(void *private, const int16_t *iq_data, size_t samples)
+static int _rf_file_close(void *private)
 {
 	rf_file_t *rf = private;
-	float *f32 = rf->data;
-	int i;
 	
-	while(samples)
+	if(rf->async)
 	{
-		for(i = 0; i < rf->samples && i < samples; i++, iq_data += 2)
-		{
-			f32[i * 2 + 0] = (float) iq_data[0] * (1.0 / 32767.0);
-			f32[i * 2 + 1] = (float) iq_data[1] * (1.0 / 32767.0);
-		}
-		
-		fwrite(rf->data, rf->data_size, i, rf->f);
+		/* Flush the remaining blocks and wait for the writer */
+		fifo_close(&rf->fifo);
+		pthread_join(rf->thread, NULL);
+		fifo_free(&rf->fifo);
 		
-		samples -= i;
+		fprintf(stderr, "file: Encoder blocked for %.3f seconds waiting for the writer\n", rf->blocked_ns / 1e9);
 	}
 	
-	return(RF_OK);
-}
-
-static int _rf_file_close(void *private)
-{
-	rf_file_t *rf = private;
+	if(rf->piped && rf->pipe_mem)
+	{
+		/* Write out the partly filled buffer */
+		if(!rf->error) _rf_file_pipe_flush(rf);
+		free(rf->pipe_mem);
+	}
+	
+#ifndef _WIN32
+	if(rf->mapped)
+	{
+		if(rf->map) munmap(rf->map, rf->map_len);
+		
+		/* Trim the unused part of the last window,
+		 * and any preallocated space not written to */
+		if(ftruncate(fileno(rf->f), rf->map_offset + rf->map_pos) != 0)
+		{
+			perror("ftruncate");
+		}
+	}
+#endif
 	
 	if(rf->f && rf->f != stdout) fclose(rf->f);
 	if(rf->data) free(rf->data);
@@ -287,7 +374,7 @@ static int _rf_file_close(void *private)
 	return(RF_OK);
 }
 
-int rf_file_open(rf_t *s, char *filename, int type, int complex)
+static int _rf_file_open(rf_t *s, char *filename, int type, int complex, int buffers, int direct, size_t window, uint64_t prealloc, int piped)
 {
 	rf_file_t *rf = calloc(1, sizeof(rf_file_t));
 	
@@ -308,11 +395,38 @@ int rf_file_open(rf_t *s, char *filename, int type, int complex)
 	}
 	else if(strcmp(filename, "-") == 0)
 	{
+		if(window > 0)
+		{
+			fprintf(stderr, "The standard output cannot be memory mapped.\n");
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+		
 		rf->f = stdout;
 	}
+	else if(direct)
+	{
+#ifdef O_DIRECT
+		int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+		
+		if(fd < 0 || (rf->f = fdopen(fd, "wb")) == NULL)
+		{
+			perror("open");
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+		
+		rf->direct = 1;
+#else
+		fprintf(stderr, "O_DIRECT is not supported on this system.\n");
+		_rf_file_close(rf);
+		return(RF_ERROR);
+#endif
+	}
 	else
 	{
-		rf->f = fopen(filename, "wb");	
+		/* A shared mapping needs read and write access */
+		rf->f = fopen(filename, window > 0 ? "w+b" : "wb");
 		
 		if(!rf->f)
 		{
@@ -337,38 +451,169 @@ int rf_file_open(rf_t *s, char *filename, int type, int complex)
 		return(RF_ERROR);
 	}
 	
+	rf->convert = rf_convert_kernel(type, rf->complex, cpu_features());
+	
 	/* Double the size for complex types */
 	if(rf->complex) rf->data_size *= 2;
 	
-	/* Number of samples in the temporary buffer */
-	rf->samples = 4096;
-	
-	/* Allocate the memory, unless the output is int16 complex */
-	if(rf->type != RF_INT16 || !rf->complex)
+	if(piped)
 	{
-		rf->data = malloc(rf->data_size * rf->samples);
-		if(!rf->data)
+		rf->piped = 1;
+		rf->pipe_len = RF_FILE_PIPE_LEN;
+		
+#ifdef SPLICE_F_MOVE
+		struct stat st;
+		int fd = fileno(rf->f);
+		
+		if(fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode))
+		{
+			int r;
+			
+			/* Try to make the pipe as large as one buffer. Each
+			 * buffer must be at least as large as the pipe */
+			fcntl(fd, F_SETPIPE_SZ, RF_FILE_PIPE_LEN);
+			
+			r = fcntl(fd, F_GETPIPE_SZ);
+			if(r > 0)
+			{
+				if((size_t) r > rf->pipe_len) rf->pipe_len = r;
+				rf->splice = 1;
+			}
+		}
+#endif
+		
+		rf->pipe_mem = malloc(rf->pipe_len * 2 + RF_FILE_PIPE_ALIGN - 1);
+		if(!rf->pipe_mem)
 		{
 			perror("malloc");
 			_rf_file_close(rf);
 			return(RF_ERROR);
 		}
+		
+		rf->pipe_buf = (uint8_t *) (((uintptr_t) rf->pipe_mem + RF_FILE_PIPE_ALIGN - 1) & ~(uintptr_t) (RF_FILE_PIPE_ALIGN - 1));
+	}
+#ifndef _WIN32
+	else if(window > 0)
+	{
+		/* The windows must be page aligned, and whole
+		 * samples must never straddle two windows */
+		if(window % sysconf(_SC_PAGESIZE) != 0 || window % rf->data_size != 0)
+		{
+			fprintf(stderr, "Invalid memory map window size %zu.\n", window);
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+		
+		rf->mapped = 1;
+		rf->map_len = window;
+		
+		if(prealloc > 0)
+		{
+			int r = posix_fallocate(fileno(rf->f), 0, prealloc);
+			
+			if(r != 0)
+			{
+				fprintf(stderr, "posix_fallocate: %s\n", strerror(r));
+				_rf_file_close(rf);
+				return(RF_ERROR);
+			}
+			
+			rf->file_len = prealloc;
+		}
+		
+		if(_rf_file_map(rf, 0) != RF_OK)
+		{
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+	}
+#endif
+	else if(buffers > 0)
+	{
+		/* The writer thread makes its own large writes,
+		 * so the stream does not need a buffer */
+		setvbuf(rf->f, NULL, _IONBF, 0);
+		
+		if(fifo_init(&rf->fifo, buffers, RF_FILE_BLOCK_LEN) != 0)
+		{
+			perror("fifo_init");
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+		
+		fifo_reader_init(&rf->reader, &rf->fifo, 0);
+		
+		if(pthread_create(&rf->thread, NULL, _rf_file_writer, rf) != 0)
+		{
+			perror("pthread_create");
+			fifo_free(&rf->fifo);
+			_rf_file_close(rf);
+			return(RF_ERROR);
+		}
+		
+		rf->async = 1;
+	}
+	else
+	{
+		/* Number of samples in the temporary buffer */
+		rf->samples = 4096;
+		
+		/* Allocate the memory, unless the output is int16 complex */
+		if(rf->type != RF_INT16 || !rf->complex)
+		{
+			rf->data = malloc(rf->data_size * rf->samples);
+			if(!rf->data)
+			{
+				perror("malloc");
+				_rf_file_close(rf);
+				return(RF_ERROR);
+			}
+		}
 	}
 	
 	/* Register the callback functions */
 	s->ctx = rf;
 	s->close = _rf_file_close;
 	
-	switch(type)
+	s->write = _rf_file_write;
+	
+	return(RF_OK);
+}
+
+int rf_file_open(rf_t *s, char *filename, int type, int complex)
+{
+	return(_rf_file_open(s, filename, type, complex, 0, 0, 0, 0, 0));
+}
+
+int rf_file_open_async(rf_t *s, char *filename, int type, int complex, int buffers, int direct)
+{
+	if(buffers < 3)
 	{
-	case RF_UINT8:  s->write = rf->complex ? _rf_file_write_uint8_complex  : _rf_file_write_uint8_real;  break;
-	case RF_INT8:   s->write = rf->complex ? _rf_file_write_int8_complex   : _rf_file_write_int8_real;   break;
-	case RF_UINT16: s->write = rf->complex ? _rf_file_write_uint16_complex : _rf_file_write_uint16_real; break;
-	case RF_INT16:  s->write = rf->complex ? _rf_file_write_int16_complex  : _rf_file_write_int16_real;  break;
-	case RF_INT32:  s->write = rf->complex ? _rf_file_write_int32_complex  : _rf_file_write_int32_real;  break;
-	case RF_FLOAT:  s->write = rf->complex ? _rf_file_write_float_complex  : _rf_file_write_float_real;  break;
+		fprintf(stderr, "The file writer needs at least 3 buffers.\n");
+		return(RF_ERROR);
 	}
 	
-	return(RF_OK);
+	return(_rf_file_open(s, filename, type, complex, buffers, direct, 0, 0, 0));
+}
+
+int rf_file_open_mmap(rf_t *s, char *filename, int type, int complex, size_t window, uint64_t prealloc)
+{
+#ifdef _WIN32
+	fprintf(stderr, "Memory mapped output is not supported on this system.\n");
+	return(RF_ERROR);
+#else
+	if(window == 0)
+	{
+		fprintf(stderr, "The memory map window cannot be empty.\n");
+		return(RF_ERROR);
+	}
+	
+	return(_rf_file_open(s, filename, type, complex, 0, 0, window, prealloc, 0));
+#endif
+}
+
+int rf_file_open_pipe(rf_t *s, char *filename, int type, int complex)
+{
+	return(_rf_file_open(s, filename, type, complex, 0, 0, 0, 0, 1));
 }
 
@@ -20,5 +20,24 @@
 
 extern int rf_file_open(rf_t *s, char *filename, int type, int complex);
 
+/* Open a file written by a separate thread. Converted samples are
+ * passed to the writer through buffers of 1 MiB each, so the encoder
+ * only waits for the file once they are all full. With direct set,
+ * the file is opened with O_DIRECT to bypass the page cache */
+extern int rf_file_open_async(rf_t *s, char *filename, int type, int complex, int buffers, int direct);
+
+/* Open a file written through a memory map, one window of the given
+ * length at a time. The samples are converted straight into the page
+ * cache. The space for each window is allocated before it is mapped,
+ * with the first prealloc bytes allocated up front. The file is trimmed
+ * to the length written when closed */
+extern int rf_file_open_mmap(rf_t *s, char *filename, int type, int complex, size_t window, uint64_t prealloc);
+
+/* Open a file or pipe written from two page aligned buffers of at
+ * least 1 MiB, bypassing stdio. When the output is a pipe the buffers
+ * are passed to it with vmsplice() rather than copied, otherwise they
+ * are written with write() */
+extern int rf_file_open_pipe(rf_t *s, char *filename, int type, int complex);
+
 #endif
 
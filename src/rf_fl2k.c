@@ -25,6 +25,8 @@
 #include "fifo.h"
 #include "fir.h"
 #include "spdif.h"
+#include "rf_simd.h"
+#include "cpu.h"
 
 #define BUFFERS 4
 
@@ -40,6 +42,7 @@ typedef struct {
 	
 	int baseband;
 	int audio_mode;
+	rf_convert_t convert;
 	
 	/* Analogue audio */
 	int interp;
@@ -109,20 +112,15 @@ static int _rf_write(void *private, const int16_t *iq_data, size_t samples)
 			if(r < 0) break;
 		}
 		
-		for(i = 0; i < r && i < samples; i++)
-		{
-			buf[0][i] = (iq_data[i * 2] - INT16_MIN) >> 8;
-		}
+		i = r < samples ? r : samples;
 		
+		/* I is sent on the red channel, Q on the green */
+		rf->convert(buf[0], iq_data, i);
 		fifo_write(&rf->buffer[0], i);
 		
 		if(!rf->baseband)
 		{
-			for(i = 0; i < r && i < samples; i++)
-			{
-				buf[1][i] = (iq_data[i * 2 + 1] - INT16_MIN) >> 8;
-			}
-			
+			rf->convert(buf[1], iq_data + 1, i);
 			fifo_write(&rf->buffer[1], i);
 		}
 		
@@ -293,6 +291,9 @@ int rf_fl2k_open(rf_t *s, const char *device, unsigned int sample_rate, int base
 	rf->baseband = baseband ? 1 : 0;
 	rf->audio_mode = audio_mode;
 	
+	/* The DAC channels take unsigned 8-bit samples */
+	rf->convert = rf_convert_kernel(RF_UINT8, 0, cpu_features());
+	
 	r = device ? atoi(device) : 0;
 	
 	fl2k_open(&rf->d, r);
@@ -25,6 +25,8 @@
 #include "rf.h"
 #include "fifo.h"
 #include "fir.h"
+#include "rf_simd.h"
+#include "cpu.h"
 
 /* Value from host/libhackrf/src/hackrf.c */
 #define TRANSFER_BUFFER_SIZE 262144
@@ -65,6 +67,7 @@ typedef struct {
 	/* Buffers */
 	fifo_t buffers;
 	fifo_reader_t buffers_reader;
+	rf_convert_t convert;
 	
 	fifo_t audio_buffers;
 	fifo_reader_t audio_buffers_reader;
@@ -247,13 +250,13 @@ static int _rf_write(void *private, const int16_t *iq_data, size_t samples)
 {
 	hackrf_t *rf = private;
 	int8_t *iq8 = NULL;
-	int i, r;
+	size_t n;
+	int r;
 	
 	/* Report some stats every ~1 second */
 	_rf_write_print_stats(rf, samples);
 	
 	r = 0;
-	samples *= 2;
 	
 	while(samples > 0)
 	{
@@ -261,15 +264,16 @@ static int _rf_write(void *private, const int16_t *iq_data, size_t samples)
 		
 		if(r < 0) break;
 		
-		for(i = 0; i < r && i < samples; i++)
-		{
-			iq8[i] = iq_data[i] >> 8;
-		}
+		/* The buffers always hold whole I/Q pairs */
+		n = r / 2;
+		if(n > samples) n = samples;
 		
-		fifo_write(&rf->buffers, i);
+		rf->convert(iq8, iq_data, n);
 		
-		iq_data += i;
-		samples -= i;
+		fifo_write(&rf->buffers, n * 2);
+		
+		iq_data += n * 2;
+		samples -= n;
 	}
 	
 	return(r >= 0 ? RF_OK : RF_ERROR);
@@ -542,6 +546,9 @@ int rf_hackrf_open(rf_t *s, const char *serial, uint32_t sample_rate, uint64_t f
 	fifo_init(&rf->buffers, r, TRANSFER_BUFFER_SIZE);
 	fifo_reader_init(&rf->buffers_reader, &rf->buffers, r / 2);
 	
+	/* The HackRF takes signed 8-bit I/Q samples */
+	rf->convert = rf_convert_kernel(RF_INT8, 1, cpu_features());
+	
 	/* Begin transmitting */
 	r = hackrf_start_tx(rf->d, baseband ? _tx_callback_hackdac : _tx_callback, rf);
 	if(r != HACKRF_SUCCESS)
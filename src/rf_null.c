@@ -0,0 +1,78 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "rf.h"
+
+/* Null sink. Samples are counted and discarded, allowing the
+ * speed of the encoder to be measured without any I/O */
+typedef struct {
+	uint64_t samples;
+	uint64_t audio_samples;
+} rf_null_t;
+
+static int _rf_null_write(void *private, const int16_t *iq_data, size_t samples)
+{
+	rf_null_t *rf = private;
+	
+	rf->samples += samples;
+	
+	return(RF_OK);
+}
+
+static int _rf_null_write_audio(void *private, const int16_t *audio, size_t samples)
+{
+	rf_null_t *rf = private;
+	
+	rf->audio_samples += samples;
+	
+	return(RF_OK);
+}
+
+static int _rf_null_close(void *private)
+{
+	rf_null_t *rf = private;
+	
+	fprintf(stderr, "null: Discarded %" PRIu64 " samples and %" PRIu64 " audio samples\n", rf->samples, rf->audio_samples);
+	
+	free(rf);
+	
+	return(RF_OK);
+}
+
+int rf_null_open(rf_t *s)
+{
+	rf_null_t *rf = calloc(1, sizeof(rf_null_t));
+	
+	if(!rf)
+	{
+		perror("calloc");
+		return(RF_ERROR);
+	}
+	
+	/* Register the callback functions */
+	s->ctx = rf;
+	s->write = _rf_null_write;
+	s->write_audio = _rf_null_write_audio;
+	s->close = _rf_null_close;
+	
+	return(RF_OK);
+}
+
@@ -0,0 +1,256 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "video.h"
+#include "rf.h"
+#include "rf_simd.h"
+#include "cpu.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Shared memory sink. See rf_shm.h for the layout */
+typedef struct {
+	char *name;
+	const vid_t *vid;
+	
+	void *map;
+	size_t map_len;
+	
+	rf_shm_header_t *header;
+	rf_shm_line_t *lines;
+	uint8_t *samples;
+	size_t sample_size;
+	rf_convert_t convert;
+	
+	/* Local copies of the counters */
+	uint64_t nsamples;
+	uint64_t nlines;
+	
+} rf_shm_t;
+
+static uint64_t _pow2(uint64_t x)
+{
+	uint64_t r = 1;
+	
+	while(r < x) r <<= 1;
+	
+	return(r);
+}
+
+static int _rf_shm_write(void *private, const int16_t *iq_data, size_t samples)
+{
+	rf_shm_t *rf = private;
+	rf_shm_header_t *h = rf->header;
+	rf_shm_line_t *l;
+	uint64_t mask = h->samples_len - 1;
+	size_t x, i, n;
+	
+	/* Mark the samples about to be overwritten before touching them */
+	atomic_store_explicit(&h->samples_reserved, rf->nsamples + samples, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	
+	for(x = 0; x < samples; x += n)
+	{
+		/* Copy up to the end of the ring, then wrap */
+		i = (rf->nsamples + x) & mask;
+		n = h->samples_len - i;
+		if(n > samples - x) n = samples - x;
+		
+		rf->convert(&rf->samples[i * rf->sample_size], &iq_data[x * 2], n);
+	}
+	
+	atomic_store_explicit(&h->samples_written, rf->nsamples + samples, memory_order_release);
+	
+	/* Invalidate the line record while it is updated */
+	l = &rf->lines[rf->nlines & (h->line_records - 1)];
+	
+	atomic_store_explicit(&l->seq, UINT64_MAX, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	
+	l->sample = rf->nsamples;
+	l->frame = rf->vid->frame;
+	l->line = rf->vid->line;
+	l->width = samples;
+	
+	atomic_store_explicit(&l->seq, rf->nlines, memory_order_release);
+	
+	rf->nsamples += samples;
+	rf->nlines++;
+	
+	atomic_store_explicit(&h->lines_written, rf->nlines, memory_order_release);
+	
+	return(RF_OK);
+}
+
+static int _rf_shm_close(void *private)
+{
+	rf_shm_t *rf = private;
+	
+	if(rf->map)
+	{
+		atomic_store_explicit(&rf->header->state, RF_SHM_CLOSED, memory_order_release);
+		munmap(rf->map, rf->map_len);
+		
+		/* Readers with the object mapped can still finish with it */
+		shm_unlink(rf->name);
+		
+		fprintf(stderr, "shm: Published %" PRIu64 " samples in %" PRIu64 " lines\n", rf->nsamples, rf->nlines);
+	}
+	
+	free(rf->name);
+	free(rf);
+	
+	return(RF_OK);
+}
+
+int rf_shm_open(rf_t *s, const char *name, const vid_t *vid, int complex)
+{
+	rf_shm_t *rf;
+	rf_shm_header_t *h;
+	uint64_t samples_len;
+	uint32_t line_records;
+	size_t offset;
+	uint32_t i;
+	int fd;
+	
+	rf = calloc(1, sizeof(rf_shm_t));
+	if(!rf)
+	{
+		perror("calloc");
+		return(RF_ERROR);
+	}
+	
+	rf->vid = vid;
+	
+	/* Real outputs are published without the unused Q samples */
+	rf->sample_size = sizeof(int16_t) * (complex ? 2 : 1);
+	rf->convert = rf_convert_kernel(RF_INT16, complex, cpu_features());
+	
+	/* Object names begin with a single slash */
+	if(name == NULL || *name == '\0') name = "hacktv";
+	if(*name == '/') name++;
+	
+	rf->name = malloc(strlen(name) + 2);
+	if(!rf->name)
+	{
+		perror("malloc");
+		_rf_shm_close(rf);
+		return(RF_ERROR);
+	}
+	
+	sprintf(rf->name, "/%s", name);
+	
+	/* Hold about one second of samples, and enough
+	 * line records to cover all the lines in the ring */
+	samples_len = _pow2(vid->sample_rate);
+	line_records = _pow2(samples_len / vid->width + 1);
+	
+	offset = RF_SHM_HEADER_LEN + line_records * sizeof(rf_shm_line_t);
+	offset = (offset + RF_SHM_HEADER_LEN - 1) & ~(size_t) (RF_SHM_HEADER_LEN - 1);
+	rf->map_len = offset + samples_len * rf->sample_size;
+	
+	/* Replace any object left behind, rather than
+	 * resizing one that readers may have mapped */
+	shm_unlink(rf->name);
+	
+	fd = shm_open(rf->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0)
+	{
+		perror("shm_open");
+		_rf_shm_close(rf);
+		return(RF_ERROR);
+	}
+	
+	if(ftruncate(fd, rf->map_len) != 0)
+	{
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(rf->name);
+		_rf_shm_close(rf);
+		return(RF_ERROR);
+	}
+	
+	rf->map = mmap(NULL, rf->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if(rf->map == MAP_FAILED)
+	{
+		perror("mmap");
+		rf->map = NULL;
+		shm_unlink(rf->name);
+		_rf_shm_close(rf);
+		return(RF_ERROR);
+	}
+	
+	rf->header = h = rf->map;
+	rf->lines = (rf_shm_line_t *) ((uint8_t *) rf->map + RF_SHM_HEADER_LEN);
+	rf->samples = (uint8_t *) rf->map + offset;
+	
+	/* The new object is zero filled. No line record is valid yet */
+	for(i = 0; i < line_records; i++)
+	{
+		atomic_init(&rf->lines[i].seq, UINT64_MAX);
+	}
+	
+	memcpy(h->magic, RF_SHM_MAGIC, sizeof(h->magic));
+	h->version = RF_SHM_VERSION;
+	h->header_len = RF_SHM_HEADER_LEN;
+	h->sample_rate = vid->sample_rate;
+	h->flags = complex ? RF_SHM_COMPLEX : 0;
+	h->frame_rate_num = vid->conf.frame_rate.num;
+	h->frame_rate_den = vid->conf.frame_rate.den;
+	h->lines = vid->conf.lines;
+	h->line_records = line_records;
+	h->samples_len = samples_len;
+	h->samples_offset = offset;
+	atomic_init(&h->samples_reserved, 0);
+	atomic_init(&h->samples_written, 0);
+	atomic_init(&h->lines_written, 0);
+	
+	/* Publish the header last */
+	atomic_store_explicit(&h->state, RF_SHM_RUNNING, memory_order_release);
+	
+	fprintf(stderr, "shm: Publishing to %s, %" PRIu64 " samples and %u line records\n", rf->name, samples_len, line_records);
+	
+	/* Register the callback functions */
+	s->ctx = rf;
+	s->write = _rf_shm_write;
+	s->close = _rf_shm_close;
+	
+	return(RF_OK);
+}
+
+#else
+
+int rf_shm_open(rf_t *s, const char *name, const vid_t *vid, int complex)
+{
+	fprintf(stderr, "Shared memory output is not supported on this system.\n");
+	return(RF_ERROR);
+}
+
+#endif
+
@@ -0,0 +1,132 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _RF_SHM_H
+#define _RF_SHM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Shared memory ring buffer sink.
+ *
+ * The output is published as the POSIX shared memory object /<name>,
+ * which readers open read-only with shm_open() and mmap(). The writer
+ * never waits for readers. A reader that falls more than a ring behind
+ * sees its data overwritten, and can detect it with the counters below.
+ * All fields are in the host byte order and naturally aligned.
+ *
+ * The object has three parts:
+ *
+ * Header, at offset 0 (rf_shm_header_t):
+ *
+ *    0  char[8]  magic             "HACKTVRB"
+ *    8  uint32   version           1
+ *   12  uint32   header_len        Offset of the line records, 4096
+ *   16  uint32   sample_rate       Samples per second
+ *   20  uint32   flags             Bit 0 set for complex output
+ *   24  uint32   frame_rate_num    Frame rate as a fraction
+ *   28  uint32   frame_rate_den
+ *   32  uint32   lines             Lines per frame
+ *   36  uint32   line_records      Number of line records, a power of 2
+ *   40  uint64   samples_len       Number of samples in the ring, a power of 2
+ *   48  uint64   samples_offset    Offset of the sample ring
+ *   56  uint64   samples_reserved  Samples the writer has started writing
+ *   64  uint64   samples_written   Samples the writer has finished writing
+ *   72  uint64   lines_written     Line records written
+ *   80  uint32   state             1 while running, 2 once the writer has closed
+ *
+ * Line records, at header_len (rf_shm_line_t, 32 bytes each). Line n
+ * is in record n % line_records:
+ *
+ *    0  uint64   seq               n, or all ones while being written
+ *    8  uint64   sample            Number of the first sample of the line
+ *   16  int32    frame             Frame number
+ *   20  int32    line              Line number in the frame, from 1
+ *   24  uint32   width             Number of samples in the line
+ *   28  uint32   reserved
+ *
+ * Sample ring, at samples_offset. For complex output each sample is an
+ * int16 I/Q pair, and sample k is at samples_offset + (k % samples_len) * 4.
+ * For real output each sample is a single int16, at samples_offset +
+ * (k % samples_len) * 2.
+ *
+ * Every counter only increases. The writer adds each line as follows:
+ *
+ * 1. Sets samples_reserved to the end of the line
+ * 2. Writes the samples into the ring
+ * 3. Sets samples_written to the end of the line
+ * 4. Sets seq of the line record to all ones, writes the record, then
+ *    sets seq to the line number
+ * 5. Sets lines_written to the line number + 1
+ *
+ * A reader follows line n once n < lines_written. It reads the record,
+ * and if seq is n both before and after, the record is good. It then
+ * copies the samples. Once copied, it reads samples_reserved again. If
+ * samples_reserved - sample > samples_len, the samples were overwritten
+ * while being copied and must be discarded.
+ *
+ * A reader can also follow the samples alone, using samples_written and
+ * samples_reserved in the same way. Each counter is written with release
+ * and should be read with acquire semantics.
+*/
+
+#define RF_SHM_MAGIC      "HACKTVRB"
+#define RF_SHM_VERSION    1
+#define RF_SHM_HEADER_LEN 4096
+
+#define RF_SHM_COMPLEX    (1 << 0)
+
+#define RF_SHM_RUNNING    1
+#define RF_SHM_CLOSED     2
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_len;
+	uint32_t sample_rate;
+	uint32_t flags;
+	uint32_t frame_rate_num;
+	uint32_t frame_rate_den;
+	uint32_t lines;
+	uint32_t line_records;
+	uint64_t samples_len;
+	uint64_t samples_offset;
+	atomic_uint_least64_t samples_reserved;
+	atomic_uint_least64_t samples_written;
+	atomic_uint_least64_t lines_written;
+	atomic_uint state;
+} rf_shm_header_t;
+
+typedef struct {
+	atomic_uint_least64_t seq;
+	uint64_t sample;
+	int32_t frame;
+	int32_t line;
+	uint32_t width;
+	uint32_t reserved;
+} rf_shm_line_t;
+
+struct vid_t;
+
+/* Open the shared memory sink. The frame and line numbers of each
+ * line are read from vid as it is written. The ring holds about one
+ * second of samples. Any existing object with the same name is
+ * replaced, and the object is removed again on close */
+extern int rf_shm_open(rf_t *s, const char *name, const struct vid_t *vid, int complex);
+
+#endif
+
@@ -0,0 +1,445 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Sample format converters for the RF sinks. Each SIMD kernel converts
+ * a block of samples at a time and leaves the remainder to the plain C
+ * version. The float kernels divide by 32767 in single precision, which
+ * gives the same result as the C multiply in double precision for every
+ * int16 value. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rf.h"
+#include "rf_simd.h"
+#include "cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Generate the real and complex plain C converters for one sample type */
+#define _RF_CONVERT_SCALAR(name, type, expr) \
+static void _##name##_real_scalar(void *dst, const int16_t *src, size_t samples) \
+{ \
+	type *o = dst; \
+	size_t x; \
+	int v; \
+	\
+	for(x = 0; x < samples; x++) \
+	{ \
+		v = src[x * 2]; \
+		o[x] = expr; \
+	} \
+} \
+\
+static void _##name##_complex_scalar(void *dst, const int16_t *src, size_t samples) \
+{ \
+	type *o = dst; \
+	size_t x; \
+	int v; \
+	\
+	for(x = 0; x < samples * 2; x++) \
+	{ \
+		v = src[x]; \
+		o[x] = expr; \
+	} \
+}
+
+_RF_CONVERT_SCALAR(uint8, uint8_t, (v - INT16_MIN) >> 8)
+_RF_CONVERT_SCALAR(int8, int8_t, v >> 8)
+_RF_CONVERT_SCALAR(uint16, uint16_t, v - INT16_MIN)
+_RF_CONVERT_SCALAR(int16, int16_t, v)
+_RF_CONVERT_SCALAR(int32, int32_t, (int32_t) ((uint32_t) v * 65537))
+_RF_CONVERT_SCALAR(float, float, (float) v * (1.0 / 32767.0))
+
+/* Generate the real and complex converters for one sample type from a
+ * block kernel, _<name>_<isa>(), which converts two vectors of samples.
+ * A block is width samples. The real converters stop a block early so
+ * the last Q sample is never read. */
+#define _RF_CONVERT_SIMD(name, type, isa, attr, width) \
+attr static void _##name##_real_##isa(void *dst, const int16_t *src, size_t samples) \
+{ \
+	type *o = dst; \
+	size_t x; \
+	\
+	for(x = 0; x + width < samples; x += width) \
+	{ \
+		_##name##_##isa(&o[x], _deint_##isa(&src[x * 2]), _deint_##isa(&src[x * 2 + width])); \
+	} \
+	\
+	_##name##_real_scalar(&o[x], &src[x * 2], samples - x); \
+} \
+\
+attr static void _##name##_complex_##isa(void *dst, const int16_t *src, size_t samples) \
+{ \
+	type *o = dst; \
+	size_t x; \
+	\
+	for(x = 0; x + width <= samples * 2; x += width) \
+	{ \
+		_##name##_##isa(&o[x], _load_##isa(&src[x]), _load_##isa(&src[x + width / 2])); \
+	} \
+	\
+	_##name##_complex_scalar(&o[x], &src[x], samples - x / 2); \
+}
+
+/* Generate the table of converters for one instruction set, indexed by
+ * the RF_* sample type and then real or complex */
+#define _RF_CONVERT_TABLE(isa) { \
+	{ _uint8_real_##isa,  _uint8_complex_##isa  }, \
+	{ _int8_real_##isa,   _int8_complex_##isa   }, \
+	{ _uint16_real_##isa, _uint16_complex_##isa }, \
+	{ _int16_real_##isa,  _int16_complex_##isa  }, \
+	{ _int32_real_##isa,  _int32_complex_##isa  }, \
+	{ _float_real_##isa,  _float_complex_##isa  }, \
+}
+
+static const rf_convert_t _scalar[6][2] = _RF_CONVERT_TABLE(scalar);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* SSE2, blocks of 16 samples */
+
+__attribute__((target("sse2")))
+static inline __m128i _load_sse2(const int16_t *src)
+{
+	return(_mm_loadu_si128((const __m128i *) src));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i _deint_sse2(const int16_t *src)
+{
+	/* Sign extend the I sample of each pair and pack them */
+	__m128i a = _mm_loadu_si128((const __m128i *) &src[0]);
+	__m128i b = _mm_loadu_si128((const __m128i *) &src[8]);
+	
+	a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+	b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	
+	return(_mm_packs_epi32(a, b));
+}
+
+__attribute__((target("sse2")))
+static inline void _int8_sse2(void *dst, __m128i a, __m128i b)
+{
+	a = _mm_srai_epi16(a, 8);
+	b = _mm_srai_epi16(b, 8);
+	_mm_storeu_si128((__m128i *) dst, _mm_packs_epi16(a, b));
+}
+
+__attribute__((target("sse2")))
+static inline void _uint8_sse2(void *dst, __m128i a, __m128i b)
+{
+	a = _mm_srai_epi16(a, 8);
+	b = _mm_srai_epi16(b, 8);
+	a = _mm_xor_si128(_mm_packs_epi16(a, b), _mm_set1_epi8(-128));
+	_mm_storeu_si128((__m128i *) dst, a);
+}
+
+__attribute__((target("sse2")))
+static inline void _int16_sse2(void *dst, __m128i a, __m128i b)
+{
+	_mm_storeu_si128((__m128i *) dst + 0, a);
+	_mm_storeu_si128((__m128i *) dst + 1, b);
+}
+
+__attribute__((target("sse2")))
+static inline void _uint16_sse2(void *dst, __m128i a, __m128i b)
+{
+	const __m128i m = _mm_set1_epi16(INT16_MIN);
+	
+	_int16_sse2(dst, _mm_xor_si128(a, m), _mm_xor_si128(b, m));
+}
+
+__attribute__((target("sse2")))
+static inline void _int32_sse2(void *dst, __m128i a, __m128i b)
+{
+	__m128i *o = dst;
+	__m128i v[4];
+	int i;
+	
+	v[0] = _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16);
+	v[1] = _mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16);
+	v[2] = _mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16);
+	v[3] = _mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16);
+	
+	for(i = 0; i < 4; i++)
+	{
+		_mm_storeu_si128(&o[i], _mm_add_epi32(_mm_slli_epi32(v[i], 16), v[i]));
+	}
+}
+
+__attribute__((target("sse2")))
+static inline void _float_sse2(void *dst, __m128i a, __m128i b)
+{
+	const __m128 d = _mm_set1_ps(32767.0f);
+	float *o = dst;
+	__m128i v[4];
+	int i;
+	
+	v[0] = _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16);
+	v[1] = _mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16);
+	v[2] = _mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16);
+	v[3] = _mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16);
+	
+	for(i = 0; i < 4; i++)
+	{
+		_mm_storeu_ps(&o[i * 4], _mm_div_ps(_mm_cvtepi32_ps(v[i]), d));
+	}
+}
+
+_RF_CONVERT_SIMD(uint8,  uint8_t,  sse2, __attribute__((target("sse2"))), 16)
+_RF_CONVERT_SIMD(int8,   int8_t,   sse2, __attribute__((target("sse2"))), 16)
+_RF_CONVERT_SIMD(uint16, uint16_t, sse2, __attribute__((target("sse2"))), 16)
+_RF_CONVERT_SIMD(int16,  int16_t,  sse2, __attribute__((target("sse2"))), 16)
+_RF_CONVERT_SIMD(int32,  int32_t,  sse2, __attribute__((target("sse2"))), 16)
+_RF_CONVERT_SIMD(float,  float,    sse2, __attribute__((target("sse2"))), 16)
+
+static const rf_convert_t _sse2[6][2] = _RF_CONVERT_TABLE(sse2);
+
+/* AVX2, blocks of 32 samples */
+
+__attribute__((target("avx2")))
+static inline __m256i _load_avx2(const int16_t *src)
+{
+	return(_mm256_loadu_si256((const __m256i *) src));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i _deint_avx2(const int16_t *src)
+{
+	__m256i a = _mm256_loadu_si256((const __m256i *) &src[0]);
+	__m256i b = _mm256_loadu_si256((const __m256i *) &src[16]);
+	
+	a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+	b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+	
+	/* Packing works within each 128-bit lane, restore the order */
+	return(_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+}
+
+__attribute__((target("avx2")))
+static inline void _int8_avx2(void *dst, __m256i a, __m256i b)
+{
+	a = _mm256_srai_epi16(a, 8);
+	b = _mm256_srai_epi16(b, 8);
+	a = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+	_mm256_storeu_si256((__m256i *) dst, a);
+}
+
+__attribute__((target("avx2")))
+static inline void _uint8_avx2(void *dst, __m256i a, __m256i b)
+{
+	a = _mm256_srai_epi16(a, 8);
+	b = _mm256_srai_epi16(b, 8);
+	a = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+	_mm256_storeu_si256((__m256i *) dst, _mm256_xor_si256(a, _mm256_set1_epi8(-128)));
+}
+
+__attribute__((target("avx2")))
+static inline void _int16_avx2(void *dst, __m256i a, __m256i b)
+{
+	_mm256_storeu_si256((__m256i *) dst + 0, a);
+	_mm256_storeu_si256((__m256i *) dst + 1, b);
+}
+
+__attribute__((target("avx2")))
+static inline void _uint16_avx2(void *dst, __m256i a, __m256i b)
+{
+	const __m256i m = _mm256_set1_epi16(INT16_MIN);
+	
+	_int16_avx2(dst, _mm256_xor_si256(a, m), _mm256_xor_si256(b, m));
+}
+
+__attribute__((target("avx2")))
+static inline void _int32_avx2(void *dst, __m256i a, __m256i b)
+{
+	__m256i *o = dst;
+	__m256i v[4];
+	int i;
+	
+	v[0] = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(a));
+	v[1] = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(a, 1));
+	v[2] = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(b));
+	v[3] = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(b, 1));
+	
+	for(i = 0; i < 4; i++)
+	{
+		_mm256_storeu_si256(&o[i], _mm256_add_epi32(_mm256_slli_epi32(v[i], 16), v[i]));
+	}
+}
+
+__attribute__((target("avx2")))
+static inline void _float_avx2(void *dst, __m256i a, __m256i b)
+{
+	const __m256 d = _mm256_set1_ps(32767.0f);
+	float *o = dst;
+	__m256i v[4];
+	int i;
+	
+	v[0] = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(a));
+	v[1] = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(a, 1));
+	v[2] = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(b));
+	v[3] = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(b, 1));
+	
+	for(i = 0; i < 4; i++)
+	{
+		_mm256_storeu_ps(&o[i * 8], _mm256_div_ps(_mm256_cvtepi32_ps(v[i]), d));
+	}
+}
+
+_RF_CONVERT_SIMD(uint8,  uint8_t,  avx2, __attribute__((target("avx2"))), 32)
+_RF_CONVERT_SIMD(int8,   int8_t,   avx2, __attribute__((target("avx2"))), 32)
+_RF_CONVERT_SIMD(uint16, uint16_t, avx2, __attribute__((target("avx2"))), 32)
+_RF_CONVERT_SIMD(int16,  int16_t,  avx2, __attribute__((target("avx2"))), 32)
+_RF_CONVERT_SIMD(int32,  int32_t,  avx2, __attribute__((target("avx2"))), 32)
+_RF_CONVERT_SIMD(float,  float,    avx2, __attribute__((target("avx2"))), 32)
+
+static const rf_convert_t _avx2[6][2] = _RF_CONVERT_TABLE(avx2);
+
+#endif
+
+#if defined(__ARM_NEON)
+
+/* NEON, blocks of 16 samples */
+
+static inline int16x8_t _load_neon(const int16_t *src)
+{
+	return(vld1q_s16(src));
+}
+
+static inline int16x8_t _deint_neon(const int16_t *src)
+{
+	return(vld2q_s16(src).val[0]);
+}
+
+static inline void _int8_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	vst1q_s8(dst, vcombine_s8(vshrn_n_s16(a, 8), vshrn_n_s16(b, 8)));
+}
+
+static inline void _uint8_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	int8x16_t v = vcombine_s8(vshrn_n_s16(a, 8), vshrn_n_s16(b, 8));
+	vst1q_u8(dst, veorq_u8(vreinterpretq_u8_s8(v), vdupq_n_u8(0x80)));
+}
+
+static inline void _int16_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	vst1q_s16((int16_t *) dst + 0, a);
+	vst1q_s16((int16_t *) dst + 8, b);
+}
+
+static inline void _uint16_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	const int16x8_t m = vdupq_n_s16(INT16_MIN);
+	
+	_int16_neon(dst, veorq_s16(a, m), veorq_s16(b, m));
+}
+
+static inline void _int32_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	int32_t *o = dst;
+	int32x4_t v[4];
+	int i;
+	
+	v[0] = vmovl_s16(vget_low_s16(a));
+	v[1] = vmovl_s16(vget_high_s16(a));
+	v[2] = vmovl_s16(vget_low_s16(b));
+	v[3] = vmovl_s16(vget_high_s16(b));
+	
+	for(i = 0; i < 4; i++)
+	{
+		vst1q_s32(&o[i * 4], vaddq_s32(vshlq_n_s32(v[i], 16), v[i]));
+	}
+}
+
+_RF_CONVERT_SIMD(uint8,  uint8_t,  neon, , 16)
+_RF_CONVERT_SIMD(int8,   int8_t,   neon, , 16)
+_RF_CONVERT_SIMD(uint16, uint16_t, neon, , 16)
+_RF_CONVERT_SIMD(int16,  int16_t,  neon, , 16)
+_RF_CONVERT_SIMD(int32,  int32_t,  neon, , 16)
+
+#if defined(__aarch64__)
+
+static inline void _float_neon(void *dst, int16x8_t a, int16x8_t b)
+{
+	const float32x4_t d = vdupq_n_f32(32767.0f);
+	float *o = dst;
+	int32x4_t v[4];
+	int i;
+	
+	v[0] = vmovl_s16(vget_low_s16(a));
+	v[1] = vmovl_s16(vget_high_s16(a));
+	v[2] = vmovl_s16(vget_low_s16(b));
+	v[3] = vmovl_s16(vget_high_s16(b));
+	
+	for(i = 0; i < 4; i++)
+	{
+		vst1q_f32(&o[i * 4], vdivq_f32(vcvtq_f32_s32(v[i]), d));
+	}
+}
+
+_RF_CONVERT_SIMD(float,  float,    neon, , 16)
+
+#else
+
+/* 32-bit ARM has no vector divide */
+#define _float_real_neon _float_real_scalar
+#define _float_complex_neon _float_complex_scalar
+
+#endif
+
+static const rf_convert_t _neon[6][2] = _RF_CONVERT_TABLE(neon);
+
+#endif
+
+rf_convert_t rf_convert_kernel(int type, int complex, int features)
+{
+	const rf_convert_t (*k)[2] = _scalar;
+	
+	if(type < RF_UINT8 || type > RF_FLOAT)
+	{
+		return(NULL);
+	}
+	
+#if defined(__x86_64__) || defined(__i386__)
+	if(features & CPU_SSE2)
+	{
+		k = _sse2;
+	}
+	
+	if(features & CPU_AVX2)
+	{
+		k = _avx2;
+	}
+#elif defined(__ARM_NEON)
+	if(features & CPU_NEON)
+	{
+		k = _neon;
+	}
+#else
+	(void) features;
+#endif
+	
+	return(k[type][complex ? 1 : 0]);
+}
+
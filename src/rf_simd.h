@@ -0,0 +1,50 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _RF_SIMD_H
+#define _RF_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Convert interleaved int16 I/Q samples to one of the RF_* sample types.
+ *
+ * dst: Output samples
+ * src: Interleaved I/Q pairs
+ * samples: Number of I/Q pairs
+ *
+ * The complex converters write both I and Q. The real converters write
+ * only I (src[x * 2]), and never read the final Q sample, so src may be
+ * offset by one to extract the Q channel instead.
+ *
+ * uint8:  (v - INT16_MIN) >> 8
+ * int8:   v >> 8
+ * uint16: v - INT16_MIN
+ * int16:  v
+ * int32:  (v << 16) + v
+ * float:  v / 32767.0
+*/
+typedef void (*rf_convert_t)(void *dst, const int16_t *src, size_t samples);
+
+/* Return the fastest converter for an RF_* sample type, using only the
+ * instruction sets in the features mask (normally cpu_features()).
+ * All versions produce identical output. Returns NULL for an unknown
+ * type. */
+extern rf_convert_t rf_convert_kernel(int type, int complex, int features);
+
+#endif
+
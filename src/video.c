@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "video.h"
 #include "nicam728.h"
 #include "dance.h"
@@ -42,6 +43,12 @@
  *   NTSC colour carrier (2 full lines + 1 line).
 */
 
+/* Number of blocks buffered between processes on different threads */
+#define LINE_QUEUE_DEPTH 4
+
+/* Number of times to poll for the previous process before sleeping */
+#define LINE_QUEUE_SPIN 1000
+
 #define SECAM_FM_DEV 1000e3
 #define SECAM_FM_FREQ 4328125 /* 277 fH */
 #define SECAM_CB_FREQ 4250000 /* 272 fH */
@@ -2184,13 +2191,6 @@ static void _secam_g(double *g, double f)
 	g[1] = 0.115 * (lq - rq) / d;
 }
 
-static double _dlimit(double v, double min, double max)
-{
-	if(v < min) return(min);
-	if(v > max) return(max);
-	return(v);
-}
-
 static int16_t *_burstwin(unsigned int sample_rate, double width, double rise, double level, int *len)
 {
 	int16_t *win;
@@ -2214,31 +2214,51 @@ static int16_t *_burstwin(unsigned int sample_rate, double width, double rise, d
 }
 
 /* FM modulator
- * deviation = peak deviation in Hz (+/-) from frequency */
+ * deviation = peak deviation in Hz (+/-) from frequency
+ *
+ * The modulator is a numerically controlled oscillator. Each input
+ * sample sets the phase step, which is added to a 32-bit accumulator.
+ * The top two bits of the phase select the quadrant, the next 10 bits
+ * index a quarter-wave table of cosine and sine, and the next 16 bits
+ * are corrected for using the first-order term of the Taylor series.
+ * The error of this is below 0.05 of an output LSB. */
 static int _init_fm_modulator(_mod_fm_t *fm, int sample_rate, double frequency, double deviation, double level)
 {
-	int r;
+	int64_t dev;
 	double d;
+	int i;
 	
-	fm->level   = round(INT16_MAX * level);
-	fm->counter = INT16_MAX;
-	fm->phase.i = INT32_MAX;
-	fm->phase.q = 0;
-	fm->lut     = malloc(sizeof(cint32_t) * (UINT16_MAX + 1));
+	fm->level = round(INT16_MAX * level);
+	fm->phase = 0;
+	fm->lut   = malloc(sizeof(cint16_t) * FM_NCO_QUARTER * 2);
 	
 	if(!fm->lut)
 	{
 		return(VID_OUT_OF_MEMORY);
 	}
 	
-	for(r = INT16_MIN; r <= INT16_MAX; r++)
+	for(i = 0; i < FM_NCO_QUARTER; i++)
 	{
-		d = 2.0 * M_PI / sample_rate * (frequency + (double) r / INT16_MAX * deviation);
+		d = M_PI / 2 * i / FM_NCO_QUARTER;
+		fm->lut[i * 2 + 0].i = lround(cos(d) * fm->level);
+		fm->lut[i * 2 + 0].q = lround(sin(d) * fm->level);
 		
-		fm->lut[r - INT16_MIN].i = lround(cos(d) * INT32_MAX);
-		fm->lut[r - INT16_MIN].q = lround(sin(d) * INT32_MAX);
+		/* The derivative over one step */
+		d = M_PI / 2 / FM_NCO_QUARTER * (1 << FM_NCO_DSHIFT);
+		fm->lut[i * 2 + 1].i = lround(fm->lut[i * 2].i * d);
+		fm->lut[i * 2 + 1].q = lround(fm->lut[i * 2].q * d);
 	}
 	
+	/* Phase step for a zero input sample */
+	fm->step = (uint32_t) llround(frequency / sample_rate * 4294967296.0);
+	
+	/* Phase step per unit of input, with 16 fractional bits. This
+	 * is split into two 16-bit halves so the step can be calculated
+	 * with 32-bit multiplies, wrapping with the accumulator */
+	dev = llround(deviation / sample_rate / INT16_MAX * 281474976710656.0);
+	fm->dev_hi = dev >> 16;
+	fm->dev_lo = dev & 0xFFFF;
+	
 	return(VID_OK);
 }
 
@@ -2256,47 +2276,12 @@ static int _init_fm_energy_dispersal(_mod_fm_t *fm, int sample_rate, r64_t frequ
 	return(VID_OK);
 }
 
-static void inline _fm_modulator_add(_mod_fm_t *fm, int16_t *dst, int16_t sample)
-{
-	cint32_mul(&fm->phase, &fm->phase, &fm->lut[sample - INT16_MIN]);
-	
-	dst[0] += ((fm->phase.i >> 16) * fm->level) >> 15;
-	dst[1] += ((fm->phase.q >> 16) * fm->level) >> 15;
-	
-	/* Correct the amplitude after INT16_MAX samples */
-	if(--fm->counter == 0)
-	{
-		double ra = atan2(fm->phase.q, fm->phase.i);
-		
-		fm->phase.i = lround(cos(ra) * INT32_MAX);
-		fm->phase.q = lround(sin(ra) * INT32_MAX);
-		
-		fm->counter = INT16_MAX;
-	}
-}
-
-static void inline _fm_modulator_cgain(_mod_fm_t *fm, int16_t *dst, int16_t sample, const cint16_t *g)
+static uint32_t inline _fm_step(const _mod_fm_t *fm, int16_t sample)
 {
-	/* Only used by SECAM */
-	
-	cint32_mul(&fm->phase, &fm->phase, &fm->lut[sample - INT16_MIN]);
-	
-	dst[0] = (((((fm->phase.i >> 16) * fm->level) >> 15) * g->i) >> 15)
-	       - (((((fm->phase.q >> 16) * fm->level) >> 15) * g->q) >> 15);
-	
-	/* Correct the amplitude after INT16_MAX samples */
-	if(--fm->counter == 0)
-	{
-		double ra = atan2(fm->phase.q, fm->phase.i);
-		
-		fm->phase.i = lround(cos(ra) * INT32_MAX);
-		fm->phase.q = lround(sin(ra) * INT32_MAX);
-		
-		fm->counter = INT16_MAX;
-	}
+	return(fm->step + (uint32_t) sample * fm->dev_hi + (((int32_t) sample * (int32_t) fm->dev_lo + 0x8000) >> 16));
 }
 
-static void inline _fm_modulator(_mod_fm_t *fm, int16_t *dst, int16_t sample)
+static int16_t inline _fm_energy_dispersal(_mod_fm_t *fm, int16_t sample)
 {
 	if(fm->ed_overflow.quot != 0)
 	{
@@ -2317,21 +2302,94 @@ static void inline _fm_modulator(_mod_fm_t *fm, int16_t *dst, int16_t sample)
 		}
 	}
 	
-	cint32_mul(&fm->phase, &fm->phase, &fm->lut[sample - INT16_MIN]);
+	return(sample);
+}
+
+static void _fm_modulator_secam(vid_t *s, _mod_fm_t *fm, int16_t *dst, int16_t *src, const int16_t *win, const cint16_t *bell, int samples)
+{
+	uint32_t phase[256];
+	int16_t iq[256 * 2];
+	cint16_t g[256];
+	uint32_t p = fm->phase;
+	int32_t c;
+	int x, n;
+	
+	/* Only used by SECAM. Each input sample is FM modulated, the
+	 * carrier shaped by the bell filter gain for that sample, and
+	 * then windowed and added to the I channel of dst. The carrier
+	 * is also written back over src, as the de-emphasis filter on
+	 * the next line reads the samples past the line width */
+	for(; samples > 0; samples -= n, src += n, dst += n * 2, win += n)
+	{
+		n = samples < 256 ? samples : 256;
+		
+		for(x = 0; x < n; x++)
+		{
+			p += _fm_step(fm, src[x]);
+			phase[x] = p;
+			g[x] = bell[(uint16_t) src[x]];
+		}
+		
+		s->nco_kernel(iq, phase, fm->lut, n);
+		
+		for(x = 0; x < n; x++)
+		{
+			c = ((iq[x * 2 + 0] * g[x].i) >> 15) - ((iq[x * 2 + 1] * g[x].q) >> 15);
+			src[x] = c;
+			dst[x * 2] += (src[x] * win[x]) >> 15;
+		}
+	}
+	
+	fm->phase = p;
+}
+
+static void _fm_modulator_line(vid_t *s, _mod_fm_t *fm, int16_t *dst, int samples)
+{
+	uint32_t phase[256];
+	uint32_t p = fm->phase;
+	int x, n;
 	
-	dst[0] = ((fm->phase.i >> 16) * fm->level) >> 15;
-	dst[1] = ((fm->phase.q >> 16) * fm->level) >> 15;
+	/* FM modulate a line of interleaved samples in place, taking
+	 * the input from the I channel. The phase is accumulated first,
+	 * leaving the NCO kernel with no dependency between samples */
+	for(; samples > 0; samples -= n, dst += n * 2)
+	{
+		n = samples < 256 ? samples : 256;
+		
+		for(x = 0; x < n; x++)
+		{
+			p += _fm_step(fm, _fm_energy_dispersal(fm, dst[x * 2]));
+			phase[x] = p;
+		}
+		
+		s->nco_kernel(dst, phase, fm->lut, n);
+	}
 	
-	/* Correct the amplitude after INT16_MAX samples */
-	if(--fm->counter == 0)
+	fm->phase = p;
+}
+
+static void _fm_carrier_process(vid_t *s, void *arg, const int16_t *src, int16_t *dst, int samples)
+{
+	_mod_fm_t *fm = arg;
+	uint32_t phase[256];
+	uint32_t p = fm->phase;
+	int x, n;
+	
+	/* FM modulate a block of audio */
+	for(; samples > 0; samples -= n, dst += n * 2, src += n)
 	{
-		double ra = atan2(fm->phase.q, fm->phase.i);
+		n = samples < 256 ? samples : 256;
 		
-		fm->phase.i = lround(cos(ra) * INT32_MAX);
-		fm->phase.q = lround(sin(ra) * INT32_MAX);
+		for(x = 0; x < n; x++)
+		{
+			p += _fm_step(fm, src[x]);
+			phase[x] = p;
+		}
 		
-		fm->counter = INT16_MAX;
+		s->nco_kernel(dst, phase, fm->lut, n);
 	}
+	
+	fm->phase = p;
 }
 
 static void _free_fm_modulator(_mod_fm_t *fm)
@@ -2377,11 +2435,90 @@ static void inline _am_modulator_add(_mod_am_t *am, int16_t *dst, int16_t sample
 	}
 }
 
+static void _am_carrier_process(vid_t *s, void *arg, const int16_t *src, int16_t *dst, int samples)
+{
+	int x;
+	
+	memset(dst, 0, sizeof(int16_t) * 2 * samples);
+	
+	for(x = 0; x < samples; x++)
+	{
+		_am_modulator_add(arg, &dst[x * 2], src[x]);
+	}
+}
+
 static void _free_am_modulator(_mod_am_t *am)
 {
 	/* Nothing */
 }
 
+/* Audio upsampler */
+static int _init_audio_up(vid_t *s, _audio_up_t *up)
+{
+	int pulls;
+	int r;
+	
+	r = fir_int16_resampler_init(&up->fir,
+		(r64_t) { HACKTV_AUDIO_SAMPLE_RATE * VID_AUDIO_UP, 1 },
+		(r64_t) { HACKTV_AUDIO_SAMPLE_RATE, 1 }
+	);
+	
+	/* The most 32 kHz samples that can fall due in one line. The
+	 * last VID_AUDIO_UP + 1 upsampled values are carried over to
+	 * the start of the next line */
+	pulls = (int64_t) s->max_width * HACKTV_AUDIO_SAMPLE_RATE / s->sample_rate + 1;
+	up->in = malloc(sizeof(int16_t) * pulls);
+	up->ov = calloc(VID_AUDIO_UP * (pulls + 1) + 1, sizeof(int16_t));
+	up->out = malloc(sizeof(int16_t) * s->max_width);
+	
+	if(!s->audio_pos)
+	{
+		s->audio_pos = malloc(sizeof(uint32_t) * s->max_width);
+	}
+	
+	if(r != 0 || !up->in || !up->ov || !up->out || !s->audio_pos)
+	{
+		return(VID_OUT_OF_MEMORY);
+	}
+	
+	return(VID_OK);
+}
+
+static void _audio_up_line(vid_t *s, _audio_up_t *up, int width, int pulls)
+{
+	const uint32_t *pos = s->audio_pos;
+	const int16_t *ov = up->ov;
+	int32_t f;
+	int x, i;
+	
+	/* Each 32 kHz sample produces one group of upsampled values */
+	for(i = 0; i < pulls; i++)
+	{
+		fir_int16_feed(&up->fir, &up->in[i], 1, 1);
+		fir_int16_process(&up->fir, &up->ov[VID_AUDIO_UP * (i + 1) + 1], VID_AUDIO_UP, 1);
+	}
+	
+	/* Interpolate between the upsampled values either side
+	 * of each output sample. pos has a 15-bit fraction */
+	for(x = 0; x < width; x++)
+	{
+		i = pos[x] >> 15;
+		f = pos[x] & 0x7FFF;
+		up->out[x] = ov[i] + (((ov[i + 1] - ov[i]) * f) >> 15);
+	}
+	
+	/* Carry the last group over to the next line */
+	memmove(up->ov, &up->ov[VID_AUDIO_UP * pulls], sizeof(int16_t) * (VID_AUDIO_UP + 1));
+}
+
+static void _free_audio_up(_audio_up_t *up)
+{
+	fir_int16_free(&up->fir);
+	free(up->in);
+	free(up->ov);
+	free(up->out);
+}
+
 void _test_sample_rate(const vid_config_t *conf, unsigned int sample_rate)
 {
 	int m, r;
@@ -2861,9 +2998,149 @@ static int _active_video_line(const int type, const int frame, const int line)
 	return(vy);
 }
 
-static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **lines)
+static int _init_line_desc(vid_t *s)
 {
+	_vid_line_desc_t *d;
 	const char *seq;
+	int frame, line;
+	
+	s->line_desc = calloc(s->conf.lines * 2, sizeof(_vid_line_desc_t));
+	if(!s->line_desc)
+	{
+		return(VID_OUT_OF_MEMORY);
+	}
+	
+	/* Decode the sequence codes for each line of an even and odd frame */
+	for(d = s->line_desc, frame = 0; frame < 2; frame++)
+	{
+		for(line = 1; line <= s->conf.lines; line++, d++)
+		{
+			seq = _line_sequence(s->conf.type, frame, line);
+			
+			/* Left sync pulse */
+			if(seq[0] == 'h')      d->sync |= 1 << 0;
+			else if(seq[0] == 'v') d->sync |= 1 << 1;
+			else if(seq[0] == 'V') d->sync |= 1 << 2;
+			
+			/* Middle sync pulse */
+			if(seq[3] == 'v')      d->sync |= 1 << 3;
+			else if(seq[3] == 'V') d->sync |= 1 << 4;
+			
+			/* Does this line use colour? */
+			d->burst  = seq[1] == '0';
+			d->burst |= seq[1] == '1' && frame == 0;
+			d->burst |= seq[1] == '2' && frame == 1;
+			
+			/* Calculate active video portion of this line */
+			d->active = (seq[2] == 'a' ? 1 : 0) | (seq[3] == 'a' ? 2 : 0);
+			d->al = (seq[2] == 'a' ? s->active_left : (seq[3] == 'a' ? s->half_width : -1));
+			d->ar = (seq[3] == 'a' ? s->active_left + s->active_width : (seq[2] == 'a' ? s->half_width : -1));
+			
+			d->vy = _active_video_line(s->conf.type, frame, line);
+		}
+	}
+	
+	return(VID_OK);
+}
+
+static inline const _vid_line_desc_t *_line_desc(vid_t *s, int frame, int line)
+{
+	return(&s->line_desc[(frame & 1) * s->conf.lines + line - 1]);
+}
+
+static void _vid_secam_sample(vid_t *s, vid_line_t *l, const _vid_line_desc_t *d, int vy)
+{
+	int16_t *o = l->output + 1;
+	int x, dr;
+	
+	/* The SECAM colour difference signal is sampled here rather than
+	 * in the subcarrier process, which runs on its own thread and may
+	 * be several lines behind the current frame. The samples are
+	 * passed to it in the (otherwise unused) Q channel of the line */
+	
+	/* Is this line D'r or D'b? */
+	dr = ((l->frame * s->conf.lines) + l->line) & 1;
+	
+	if(l->line == 1 || l->line == s->conf.hline)
+	{
+		/* Clear the previous line at the top of each field */
+		memset(s->secam_prev, 0, sizeof(int16_t) * s->width);
+	}
+	
+	if(s->conf.secam_field_id &&
+	   ((l->line >= 7 && l->line < 7 + s->secam_field_id_lines) ||
+	    (l->line >= 320 && l->line < 320 + s->secam_field_id_lines)))
+	{
+		/* Field identification lines are rendered by the subcarrier process */
+		return;
+	}
+	
+	if(d->active)
+	{
+		uint32_t rgb = 0x000000;
+		uint32_t *prgb = &rgb;
+		int stride = 0;
+		
+		if(s->vframe.framebuffer && vy >= 0)
+		{
+			prgb = &s->vframe.framebuffer[vy * s->vframe.line_stride];
+			stride = s->vframe.pixel_stride;
+		}
+		
+		if(dr)
+		{
+			/* D'r */
+			
+			for(x = 0; x < s->active_left + s->vframe_x; x++)
+			{
+				o[x * 2] = vid_rgb_to_yuv(s, 0x000000).v;
+			}
+			
+			for(; x < s->active_left + s->vframe_x + s->vframe.width; x++, prgb += stride)
+			{
+				_yuv16_t yuv = vid_rgb_to_yuv(s, *prgb);
+				
+				o[x * 2] = (yuv.v + s->secam_prev[x]) / 2;
+				
+				/* Store this lines D'b values to average with next line */
+				s->secam_prev[x] = yuv.u;
+			}
+			
+			for(; x < s->width; x++)
+			{
+				o[x * 2] = vid_rgb_to_yuv(s, 0x000000).v;
+			}
+		}
+		else
+		{
+			/* D'b */
+			
+			for(x = 0; x < s->active_left + s->vframe_x; x++)
+			{
+				o[x * 2] = vid_rgb_to_yuv(s, 0x000000).u;
+			}
+			
+			for(; x < s->active_left + s->vframe_x + s->vframe.width; x++, prgb += stride)
+			{
+				_yuv16_t yuv = vid_rgb_to_yuv(s, *prgb);
+				
+				o[x * 2] = (yuv.u + s->secam_prev[x]) / 2;
+				
+				/* Store this lines D'r values to average with next line */
+				s->secam_prev[x] = yuv.v;
+			}
+			
+			for(; x < s->width; x++)
+			{
+				o[x * 2] = vid_rgb_to_yuv(s, 0x000000).u;
+			}
+		}
+	}
+}
+
+static inline __attribute__((always_inline)) int _vid_raster_line(vid_t *s, vid_line_t **lines, const int colour_mode)
+{
+	const _vid_line_desc_t *d;
 	int x;
 	int vy;
 	int pal = 0;
@@ -2880,8 +3157,8 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	l->audio     = NULL;
 	l->audio_len = 0;
 	
-	seq = _line_sequence(s->conf.type, l->frame, l->line);
-	vy = _active_video_line(s->conf.type, l->frame, l->line);
+	d = _line_desc(s, l->frame, l->line);
+	vy = d->vy;
 	
 	/* Shift the lines by one if the source
 	 * video has the bottom field first */
@@ -2894,13 +3171,11 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	/* Check for out of bounds */
 	if(vy < 0 || vy >= s->vframe.height) vy = -1;
 	
-	if(s->conf.colour_mode == VID_PAL ||
-	   s->conf.colour_mode == VID_NTSC)
+	if(colour_mode == VID_PAL ||
+	   colour_mode == VID_NTSC)
 	{
 		/* Does this line use colour? */
-		pal  = seq[1] == '0';
-		pal |= seq[1] == '1' && (l->frame & 1) == 0;
-		pal |= seq[1] == '2' && (l->frame & 1) == 1;
+		pal = d->burst;
 		
 		/* Calculate colour sub-carrier lookup-positions for the start of this line */
 		l->lut = &s->colour_lookup[s->colour_lookup_offset];
@@ -2909,7 +3184,7 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 		s->colour_lookup_offset += s->width;
 		s->colour_lookup_offset %= s->colour_lookup_width;
 		
-		if(s->conf.colour_mode == VID_PAL && pal &&
+		if(colour_mode == VID_PAL && pal &&
 		   (l->frame + l->line) & 1)
 		{
 			pal = -1;
@@ -2918,13 +3193,13 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 		/* Clear the chrominance buffer */
 		if(pal) memset(s->chrominance_buffer, 0, sizeof(int16_t) * 2 * s->width);
 	}
-	else if(s->conf.colour_mode == VID_APOLLO_FSC)
+	else if(colour_mode == VID_APOLLO_FSC)
 	{
 		/* Apollo Field Sequential Colour */
 		fsc = (l->frame * 2 + (l->line < 264 ? 0 : 1)) % 3;
 		pal = 0;
 	}
-	else if(s->conf.colour_mode == VID_CBS_FSC)
+	else if(colour_mode == VID_CBS_FSC)
 	{
 		/* CBS Field Sequential Colour */
 		fsc = (l->frame * 2 + (l->line < 202 ? 0 : 1)) % 3;
@@ -2941,16 +3216,7 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	x = 0;
 	
 	/* Draw the sync pulses */
-	sc = 0x00;
-	
-	/* Left sync pulse */
-	if(seq[0] == 'h')      sc |= 1 << 0;
-	else if(seq[0] == 'v') sc |= 1 << 1;
-	else if(seq[0] == 'V') sc |= 1 << 2;
-	
-	/* Middle sync pulse */
-	if(seq[3] == 'v')      sc |= 1 << 3;
-	else if(seq[3] == 'V') sc |= 1 << 4;
+	sc = d->sync;
 	
 	if(sc)
 	{
@@ -2958,20 +3224,20 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	}
 	
 	/* Render the active video if required */
-	if(seq[2] == 'a' || seq[3] == 'a')
+	if(d->active)
 	{
 		uint32_t rgb = 0x000000;
 		uint32_t *prgb = &rgb;
 		int stride = 0;
 		int16_t *o, *oc;
+		int n;
 		
-		/* Calculate active video portion of this line */
-		al = (seq[2] == 'a' ? s->active_left : (seq[3] == 'a' ? s->half_width : -1));
-		ar = (seq[3] == 'a' ? s->active_left + s->active_width : (seq[2] == 'a' ? s->half_width : -1));
+		al = d->al;
+		ar = d->ar;
 		
 		for(x = al, o = &l->output[al * 2]; x < s->active_left + s->vframe_x; x++, o += 2)
 		{
-			*o = s->yuv_level_lookup[0x000000].y;
+			*o = vid_rgb_to_yuv(s, 0x000000).y;
 		}
 		
 		if(s->vframe.framebuffer && vy >= 0)
@@ -2982,29 +3248,34 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 		}
 		
 		oc = &s->chrominance_buffer[x * 2];
-		for(; x < s->active_left + s->vframe_x + s->vframe.width && x < ar; x++, o += 2, oc += 2, prgb += stride)
+		
+		if(colour_mode == VID_APOLLO_FSC ||
+		   colour_mode == VID_CBS_FSC)
 		{
-			rgb = *prgb & 0xFFFFFF;
-			
-			if(s->conf.colour_mode == VID_APOLLO_FSC ||
-			   s->conf.colour_mode == VID_CBS_FSC)
+			for(; x < s->active_left + s->vframe_x + s->vframe.width && x < ar; x++, o += 2, prgb += stride)
 			{
-				rgb  = (rgb >> (8 * fsc)) & 0xFF;
+				rgb  = (*prgb >> (8 * fsc)) & 0xFF;
 				rgb |= (rgb << 8) | (rgb << 16);
+				
+				*o = vid_rgb_to_yuv(s, rgb).y;
 			}
+		}
+		else
+		{
+			n = s->active_left + s->vframe_x + s->vframe.width;
+			n = (n < ar ? n : ar) - x;
 			
-			*o = s->yuv_level_lookup[rgb].y;
-			
-			if(pal)
+			if(n > 0)
 			{
-				oc[0] = s->yuv_level_lookup[rgb].u;
-				oc[1] = s->yuv_level_lookup[rgb].v;
+				s->rgb_kernel(s, o, pal ? oc : NULL, prgb, stride, n);
+				x += n;
+				o += n * 2;
 			}
 		}
 		
 		for(; x < ar; x++, o += 2)
 		{
-			*o = s->yuv_level_lookup[0x000000].y;
+			*o = vid_rgb_to_yuv(s, 0x000000).y;
 		}
 	}
 	
@@ -3028,20 +3299,20 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 			oc[1] = (s->burst_phase.q * s->burst_win[x]) >> 15;
 		}
 		
-		/* Render the colour subcarrier */
+		/* Render the colour subcarrier. The quadrature /
+		 * imaginary result is used to render the sub-carrier */
 		o = l->output + (s->conf.s_video ? 1 : 0);
-		oc = s->chrominance_buffer;
-		for(x = 0; x < s->width; x++, o += 2, oc += 2)
-		{
-			/* The quadrature / imaginary result is used
-			 * to render the sub-carrier */
-			*o += (l->lut[x].i * oc[1] * pal +
-			       l->lut[x].q * oc[0]) >> 15;
-		}
+		s->mix_kernel(o, s->chrominance_buffer, l->lut, pal, s->width);
+	}
+	
+	/* Sample the SECAM colour difference signal */
+	if(colour_mode == VID_SECAM)
+	{
+		_vid_secam_sample(s, l, d, vy);
 	}
 	
 	/* Render the Apollo FSC flag */
-	if(s->conf.colour_mode == VID_APOLLO_FSC && fsc == 1 &&
+	if(colour_mode == VID_APOLLO_FSC && fsc == 1 &&
 	  (l->line == 18 || l->line == 281))
 	{
 		/* The Apollo colour standard transmits one colour per field
@@ -3055,7 +3326,7 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	}
 	
 	/* Render the CBS FSC flag */
-	if(s->conf.colour_mode == VID_CBS_FSC && fsc == 2 &&
+	if(colour_mode == VID_CBS_FSC && fsc == 2 &&
 	  (l->line == 1 || l->line == 203))
 	{
 		sc = 1 << (l->line == 1 ? 0 : 1);
@@ -3065,29 +3336,31 @@ static int _vid_next_line_raster(vid_t *s, void *arg, int nlines, vid_line_t **l
 	return(1);
 }
 
+/* Raster renderers specialised for each colour mode. The mode is a
+ * constant in each one, so the unused colour paths are removed */
+#define _VID_RASTER(name, mode) \
+static int name(vid_t *s, void *arg, int nlines, vid_line_t **lines) \
+{ \
+	return(_vid_raster_line(s, lines, mode)); \
+}
+
+_VID_RASTER(_vid_next_line_raster_mono, VID_MONOCHROME)
+_VID_RASTER(_vid_next_line_raster_pal, VID_PAL)
+_VID_RASTER(_vid_next_line_raster_ntsc, VID_NTSC)
+_VID_RASTER(_vid_next_line_raster_secam, VID_SECAM)
+_VID_RASTER(_vid_next_line_raster_apollo_fsc, VID_APOLLO_FSC)
+_VID_RASTER(_vid_next_line_raster_cbs_fsc, VID_CBS_FSC)
+
 static int _vid_render_secam(vid_t *s, void *arg, int nlines, vid_line_t **lines)
 {
-	const char *seq;
-	int x, vy;
+	const _vid_line_desc_t *d;
+	int x;
 	vid_line_t *l = lines[0];
-	const cint16_t *g;
 	int16_t dmin, dmax;
 	int sl = 0, sr = 0;
 	int dr;
 	
-	seq = _line_sequence(s->conf.type, l->frame, l->line);
-	vy = _active_video_line(s->conf.type, l->frame, l->line);
-	
-	/* Shift the lines by one if the source
-	 * video has the bottom field first */
-	if(vy >= 0 && s->conf.interlaced != 0 &&
-	   s->vframe.interlaced != s->conf.interlaced) vy += 1;
-	
-	/* Centre the video vertically */
-	vy -= s->vframe_y;
-	
-	/* Check for out of bounds */
-	if(vy < 0 || vy >= s->vframe.height) vy = -1;
+	d = _line_desc(s, l->frame, l->line);
 	
 	/* Is this line D'r or D'b? */
 	dr = ((l->frame * s->conf.lines) + l->line) & 1;
@@ -3108,13 +3381,13 @@ static int _vid_render_secam(vid_t *s, void *arg, int nlines, vid_line_t **lines
 		
 		if(dr)
 		{
-			level = s->yuv_level_lookup[0x000000].v; // D'r
+			level = vid_rgb_to_yuv(s, 0x000000).v; // D'r
 			dev = s->secam_fsync_level;
 			rw = 15e-6;
 		}
 		else
 		{
-			level = s->yuv_level_lookup[0x000000].u; // D'b
+			level = vid_rgb_to_yuv(s, 0x000000).u; // D'b
 			dev = -s->secam_fsync_level;
 			rw = 18e-6;
 		}
@@ -3134,99 +3407,43 @@ static int _vid_render_secam(vid_t *s, void *arg, int nlines, vid_line_t **lines
 		
 		l->vbialloc = 1;
 	}
-	else if(seq[2] == 'a' || seq[3] == 'a')
+	else if(d->active)
 	{
-		uint32_t rgb = 0x000000;
-		uint32_t *prgb = &rgb;
-		int stride = 0;
-		
-		if(s->vframe.framebuffer && vy >= 0)
+		/* Collect the colour difference samples left
+		 * in the Q channel by the raster process */
+		for(x = 0; x < s->width; x++)
 		{
-			prgb = &s->vframe.framebuffer[vy * s->vframe.line_stride];
-			stride = s->vframe.pixel_stride;
+			s->chrominance_buffer[x] = l->output[x * 2 + 1];
+			l->output[x * 2 + 1] = 0;
 		}
 		
-		if(dr)
-		{
-			/* D'r */
-			
-			for(x = 0; x < s->active_left + s->vframe_x; x++)
-			{
-				s->chrominance_buffer[x] = s->yuv_level_lookup[0x000000].v;
-			}
-			
-			for(; x < s->active_left + s->vframe_x + s->vframe.width; x++, prgb += stride)
-			{
-				s->chrominance_buffer[x] =
-					(s->yuv_level_lookup[*prgb & 0xFFFFFF].v +
-					 s->chrominance_buffer[s->width + x]) / 2;
-				
-				/* Store this lines D'b values to average with next line */
-				s->chrominance_buffer[s->width + x] = s->yuv_level_lookup[*prgb & 0xFFFFFF].u;
-			}
-			
-			for(; x < s->width; x++)
-			{
-				s->chrominance_buffer[x] = s->yuv_level_lookup[0x000000].v;
-			}
-		}
-		else
-		{
-			/* D'b */
-			
-			for(x = 0; x < s->active_left + s->vframe_x; x++)
-			{
-				s->chrominance_buffer[x] = s->yuv_level_lookup[0x000000].u;
-			}
-			
-			for(; x < s->active_left + s->vframe_x + s->vframe.width; x++, prgb += stride)
-			{
-				s->chrominance_buffer[x] =
-					(s->yuv_level_lookup[*prgb & 0xFFFFFF].u +
-					 s->chrominance_buffer[s->width + x]) / 2;
-				
-				/* Store this lines D'r values to average with next line */
-				s->chrominance_buffer[s->width + x] = s->yuv_level_lookup[*prgb & 0xFFFFFF].v;
-			}
-			
-			for(; x < s->width; x++)
-			{
-				s->chrominance_buffer[x] = s->yuv_level_lookup[0x000000].u;
-			}
-		}
-		
-		sl = s->burst_left;
-		sr = seq[3] == 'a' ? sl + s->burst_width : s->half_width;
-	}
-	
-	if(sr > sl)
-	{
-		int16_t *o;
-		
-		if(!s->conf.s_video) fir_int16_process_block(&s->secam_l_fir, l->output + s->active_left * 2, l->output + s->active_left * 2, s->active_width, 2);
-		fir_int16_process_block(&s->fm_secam_fir, s->chrominance_buffer, s->chrominance_buffer, s->width, 1);
-		iir_int16_process(&s->fm_secam_iir, s->chrominance_buffer, s->chrominance_buffer, s->width, 1);
-		
-		/* Reset the SECAM FM phase every line, alternating every third line */
-		s->fm_secam.counter = INT16_MAX;
-		s->fm_secam.phase.i = ((l->frame * s->conf.lines) + l->line) % 3 == 0 ? INT32_MAX : -INT32_MAX;
-		s->fm_secam.phase.q = 0;
-		
-		/* Limit the FM deviation */
-		dmin = s->fm_secam_dmin[dr];
-		dmax = s->fm_secam_dmax[dr];
-		
-		o = l->output + (s->conf.s_video ? 1 : 0);
-		for(x = sl; x < sr; x++)
+		sl = s->burst_left;
+		sr = d->active & 2 ? sl + s->burst_width : s->half_width;
+	}
+	
+	if(sr > sl)
+	{
+		int16_t *o;
+		
+		if(!s->conf.s_video) fir_int16_process_block(&s->secam_l_fir, l->output + s->active_left * 2, l->output + s->active_left * 2, s->active_width, 2);
+		fir_int16_process_block(&s->fm_secam_fir, s->chrominance_buffer, s->chrominance_buffer, s->width, 1);
+		iir_int16_process(&s->fm_secam_iir, s->chrominance_buffer, s->chrominance_buffer, s->width, 1);
+		
+		/* Reset the SECAM FM phase every line, alternating every third line */
+		s->fm_secam.phase = ((l->frame * s->conf.lines) + l->line) % 3 == 0 ? 0 : UINT32_C(1) << 31;
+		
+		/* Limit the FM deviation */
+		dmin = s->fm_secam_dmin[dr];
+		dmax = s->fm_secam_dmax[dr];
+		
+		for(x = sl; x < sr; x++)
 		{
 			if(s->chrominance_buffer[x] < dmin) s->chrominance_buffer[x] = dmin;
 			else if(s->chrominance_buffer[x] > dmax) s->chrominance_buffer[x] = dmax;
-			
-			g = &s->fm_secam_bell[(uint16_t) s->chrominance_buffer[x]];
-			_fm_modulator_cgain(&s->fm_secam, &s->chrominance_buffer[x], s->chrominance_buffer[x], g);
-			
-			o[x * 2] += (s->chrominance_buffer[x] * s->burst_win[x - s->burst_left]) >> 15;
 		}
+		
+		o = l->output + (s->conf.s_video ? 1 : 0);
+		_fm_modulator_secam(s, &s->fm_secam, o + sl * 2, s->chrominance_buffer + sl, s->burst_win + (sl - s->burst_left), s->fm_secam_bell, sr - sl);
 	}
 	
 	return(1);
@@ -3258,152 +3475,253 @@ static void _vid_filter_free(vid_t *s, void *arg)
 	free(p);
 }
 
-static int _vid_audio_process(vid_t *s, void *arg, int nlines, vid_line_t **lines)
+static void _vid_audio_fetch(vid_t *s, int pull)
 {
-	vid_line_t *l = lines[0];
-	int16_t audio[2] = { 0, 0 };
+	int16_t audio[2];
 	int16_t *buf;
-	int x;
 	
-	for(x = 0; x < l->width; x++)
+	if(s->audiobuffer_samples == 0)
 	{
-		int16_t add[2] = { 0, 0 };
+		av_read_audio(&s->av, &s->audiobuffer, &s->audiobuffer_samples);
 		
-		/* TODO: Replace this with a real FIR filter... */
-		s->interp += HACKTV_AUDIO_SAMPLE_RATE;
-		if(s->interp >= s->sample_rate)
+		if(s->conf.systeraudio == 1)
 		{
-			s->interp -= s->sample_rate;
-			
-			if(s->audiobuffer_samples == 0)
-			{
-				av_read_audio(&s->av, &s->audiobuffer, &s->audiobuffer_samples);
-				
-				if(s->conf.systeraudio == 1)
-				{
-					ng_invert_audio(&s->ng, s->audiobuffer, s->audiobuffer_samples);
-				}
-			}
-			
-			if(s->audiobuffer)
-			{
-				/* Fetch next sample */
-				for(int i = 0; i < 2; i++)
-				{
-					int32_t v = ((int32_t) s->audiobuffer[i] * s->conf.volume + 128) >> 8;
-					audio[i] = (v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v));
-				}
-				s->audiobuffer += 2;
-				s->audiobuffer_samples--;
-			}
-			else
-			{
-				/* No audio from the source */
-				audio[0] = 0;
-				audio[1] = 0;
-			}
-			
-			/* Feed the samples into the audio FIFO */
-			fifo_write_ptr(&s->audiofifo, (void **) &buf, 1);
-			buf[0] = audio[0];
-			buf[1] = audio[1];
-			fifo_write(&s->audiofifo, sizeof(int16_t) * 2);
-			
-			if(s->conf.am_audio_level > 0 && s->conf.am_mono_carrier != 0)
-			{
-				s->am_mono.sample = (audio[0] + audio[1]) / 2;
-			}
-			
-			if(s->conf.fm_mono_level > 0 && s->conf.fm_mono_carrier != 0)
+			ng_invert_audio(&s->ng, s->audiobuffer, s->audiobuffer_samples);
+		}
+	}
+	
+	if(s->audiobuffer)
+	{
+		/* Fetch next sample */
+		for(int i = 0; i < 2; i++)
+		{
+			int32_t v = ((int32_t) s->audiobuffer[i] * s->conf.volume + 128) >> 8;
+			audio[i] = (v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v));
+		}
+		s->audiobuffer += 2;
+		s->audiobuffer_samples--;
+	}
+	else
+	{
+		/* No audio from the source */
+		audio[0] = 0;
+		audio[1] = 0;
+	}
+	
+	/* Feed the samples into the audio FIFO */
+	fifo_write_ptr(&s->audiofifo, (void **) &buf, 1);
+	buf[0] = audio[0];
+	buf[1] = audio[1];
+	fifo_write(&s->audiofifo, sizeof(int16_t) * 2);
+	
+	/* The analogue carriers are limited and upsampled
+	 * a line at a time by _vid_audio_process() */
+	if(s->conf.am_audio_level > 0 && s->conf.am_mono_carrier != 0)
+	{
+		s->am_mono_up.in[pull] = (audio[0] + audio[1]) / 2;
+	}
+	
+	if(s->conf.fm_mono_level > 0 && s->conf.fm_mono_carrier != 0)
+	{
+		s->fm_mono_up.in[pull] = (audio[0] + audio[1]) / 2;
+	}
+	
+	if(s->conf.fm_left_level > 0 && s->conf.fm_left_carrier != 0)
+	{
+		s->fm_left_up.in[pull] = audio[0];
+	}
+	
+	if(s->conf.fm_right_level > 0 && s->conf.fm_right_carrier != 0)
+	{
+		s->fm_right_up.in[pull] = audio[1];
+	}
+	
+	if((s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0) ||
+	   s->conf.type == VID_MAC || s->conf.sis)
+	{
+		s->nicam_buf[s->nicam_buf_len++] = audio[0];
+		s->nicam_buf[s->nicam_buf_len++] = audio[1];
+		
+		if(s->nicam_buf_len == NICAM_AUDIO_LEN * 2)
+		{
+			if(s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0)
 			{
-				s->fm_mono.sample = (audio[0] + audio[1]) / 2;
-				if(s->fm_mono.limiter.width)
-				{
-					limiter_process(&s->fm_mono.limiter, &s->fm_mono.sample, &s->fm_mono.sample, &s->fm_mono.sample, 1, 1);
-				}
-				
-				/* Reduce volume of audio in A2 Stereo mode to
-				 * leave room for the pilot/mode signal */
-				if(s->conf.a2stereo) s->fm_mono.sample *= 0.95;
+				nicam_mod_input(&s->nicam, s->nicam_buf);
 			}
 			
-			if(s->conf.fm_left_level > 0 && s->conf.fm_left_carrier != 0)
+			if(s->conf.type == VID_MAC)
 			{
-				s->fm_left.sample = audio[0];
-				if(s->fm_left.limiter.width)
-				{
-					limiter_process(&s->fm_left.limiter, &s->fm_left.sample, &s->fm_left.sample, &s->fm_left.sample, 1, 1);
-				}
+				mac_write_audio(s, &s->mac.audio, 0, s->nicam_buf, NICAM_AUDIO_LEN * 2);
 			}
 			
-			if(s->conf.fm_right_level > 0 && s->conf.fm_right_carrier != 0)
+			if(s->conf.sis)
 			{
-				s->fm_right.sample = audio[1];
-				if(s->fm_right.limiter.width)
-				{
-					limiter_process(&s->fm_right.limiter, &s->fm_right.sample, &s->fm_right.sample, &s->fm_right.sample, 1, 1);
-				}
-				
-				/* Reduce volume of audio in A2 Stereo mode to
-				 * leave room for the pilot/mode signal */
-				if(s->conf.a2stereo) s->fm_right.sample *= 0.95;
+				sis_write_audio(&s->sis, s->nicam_buf);
 			}
 			
-			if((s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0) ||
-			   s->conf.type == VID_MAC || s->conf.sis)
-			{
-				s->nicam_buf[s->nicam_buf_len++] = audio[0];
-				s->nicam_buf[s->nicam_buf_len++] = audio[1];
-				
-				if(s->nicam_buf_len == NICAM_AUDIO_LEN * 2)
-				{
-					if(s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0)
-					{
-						nicam_mod_input(&s->nicam, s->nicam_buf);
-					}
-					
-					if(s->conf.type == VID_MAC)
-					{
-						mac_write_audio(s, &s->mac.audio, 0, s->nicam_buf, NICAM_AUDIO_LEN * 2);
-					}
-					
-					if(s->conf.sis)
-					{
-						sis_write_audio(&s->sis, s->nicam_buf);
-					}
-					
-					s->nicam_buf_len = 0;
-				}
-			}
+			s->nicam_buf_len = 0;
+		}
+	}
+	
+	if(s->conf.dance_level > 0 && s->conf.dance_carrier != 0)
+	{
+		s->dance_buf[s->dance_buf_len++] = audio[0];
+		s->dance_buf[s->dance_buf_len++] = audio[1];
+		
+		if(s->dance_buf_len == DANCE_A_AUDIO_LEN * 2)
+		{
+			dance_mod_input(&s->dance, s->dance_buf);
+			s->dance_buf_len = 0;
+		}
+	}
+}
+
+static void _nicam_carrier_process(vid_t *s, void *arg, const int16_t *src, int16_t *dst, int samples)
+{
+	memset(dst, 0, sizeof(int16_t) * 2 * samples);
+	nicam_mod_output(arg, dst, samples);
+}
+
+static void _dance_carrier_process(vid_t *s, void *arg, const int16_t *src, int16_t *dst, int samples)
+{
+	memset(dst, 0, sizeof(int16_t) * 2 * samples);
+	dance_mod_output(arg, dst, samples);
+}
+
+static void _add_carrier(vid_t *s, vid_carrier_process_t process, void *arg, const int16_t *src)
+{
+	_vid_carrier_t *c = &s->carriers[s->ncarriers++];
+	
+	c->process = process;
+	c->arg = arg;
+	c->src = src;
+}
+
+static void _vid_audio_mix(vid_t *s, int16_t *dst, int samples)
+{
+	int32_t acc[256 * 2];
+	int16_t carrier[256 * 2];
+	const _vid_carrier_t *c;
+	int x, i, n;
+	
+	/* Sum every active carrier into the line with a single pass
+	 * over the output, saturating once per sample */
+	for(x = 0; x < samples; x += n, dst += n * 2)
+	{
+		n = samples - x < 256 ? samples - x : 256;
+		
+		for(i = 0; i < n * 2; i++)
+		{
+			acc[i] = dst[i];
+		}
+		
+		for(c = s->carriers; c < &s->carriers[s->ncarriers]; c++)
+		{
+			c->process(s, c->arg, c->src ? &c->src[x] : NULL, carrier, n);
 			
-			if(s->conf.dance_level > 0 && s->conf.dance_carrier != 0)
+			for(i = 0; i < n * 2; i++)
 			{
-				s->dance_buf[s->dance_buf_len++] = audio[0];
-				s->dance_buf[s->dance_buf_len++] = audio[1];
-				
-				if(s->dance_buf_len == DANCE_A_AUDIO_LEN * 2)
-				{
-					dance_mod_input(&s->dance, s->dance_buf);
-					s->dance_buf_len = 0;
-				}
+				acc[i] += carrier[i];
 			}
 		}
 		
-		if(s->conf.fm_mono_level > 0 && s->conf.fm_mono_carrier != 0)
+		for(i = 0; i < n * 2; i++)
 		{
-			_fm_modulator_add(&s->fm_mono, add, s->fm_mono.sample);
+			dst[i] = acc[i] < INT16_MIN ? INT16_MIN : (acc[i] > INT16_MAX ? INT16_MAX : acc[i]);
 		}
+	}
+}
+
+static void _vid_audio_limit(vid_t *s, _mod_fm_t *fm, _audio_up_t *up, int pulls, int a2)
+{
+	int i;
+	
+	/* Limit the line's 32 kHz samples in one block */
+	if(fm->limiter.width)
+	{
+		limiter_process(&fm->limiter, up->in, up->in, up->in, pulls, 1);
+	}
+	
+	/* Reduce volume of audio in A2 Stereo mode to
+	 * leave room for the pilot/mode signal */
+	if(a2)
+	{
+		for(i = 0; i < pulls; i++)
+		{
+			up->in[i] *= 0.95;
+		}
+	}
+}
+
+static int _vid_audio_process(vid_t *s, void *arg, int nlines, vid_line_t **lines)
+{
+	vid_line_t *l = lines[0];
+	uint32_t *pos = s->audio_pos;
+	uint32_t base = 0;
+	uint64_t mul;
+	int pulls = 0;
+	int x, i, n;
+	
+	/* Map the interpolation counter onto the upsampled audio,
+	 * with a 15-bit fraction between upsampled values */
+	mul = (UINT64_C(1) << 51) / s->sample_rate;
+	
+	/* Step through the line one 32 kHz sample period at a time,
+	 * fetching the next sample as it falls due */
+	for(x = 0; x < l->width;)
+	{
+		n = (s->sample_rate - 1 - s->interp) / HACKTV_AUDIO_SAMPLE_RATE;
+		if(n > l->width - x) n = l->width - x;
 		
-		if(s->conf.fm_left_level > 0 && s->conf.fm_left_carrier != 0)
+		if(pos)
 		{
-			_fm_modulator_add(&s->fm_left, add, s->fm_left.sample);
+			for(i = 1; i <= n; i++)
+			{
+				*(pos++) = base + (((uint64_t) (s->interp + i * HACKTV_AUDIO_SAMPLE_RATE) * mul) >> 32);
+			}
 		}
 		
-		if(s->conf.fm_right_level > 0 && s->conf.fm_right_carrier != 0)
+		s->interp += n * HACKTV_AUDIO_SAMPLE_RATE;
+		x += n;
+		
+		if(x == l->width) break;
+		
+		/* The next sample falls due on this one */
+		s->interp += HACKTV_AUDIO_SAMPLE_RATE - s->sample_rate;
+		_vid_audio_fetch(s, pulls++);
+		base += VID_AUDIO_UP << 15;
+		
+		if(pos)
 		{
-			int16_t a2 = s->fm_right.sample;
-			
-			if(s->conf.a2stereo)
+			*(pos++) = base + (((uint64_t) s->interp * mul) >> 32);
+		}
+		
+		x++;
+	}
+	
+	/* Prepare the audio for each carrier */
+	if(s->conf.fm_mono_level > 0 && s->conf.fm_mono_carrier != 0)
+	{
+		_vid_audio_limit(s, &s->fm_mono, &s->fm_mono_up, pulls, s->conf.a2stereo);
+		_audio_up_line(s, &s->fm_mono_up, l->width, pulls);
+	}
+	
+	if(s->conf.fm_left_level > 0 && s->conf.fm_left_carrier != 0)
+	{
+		_vid_audio_limit(s, &s->fm_left, &s->fm_left_up, pulls, 0);
+		_audio_up_line(s, &s->fm_left_up, l->width, pulls);
+	}
+	
+	if(s->conf.fm_right_level > 0 && s->conf.fm_right_carrier != 0)
+	{
+		int16_t *a2 = s->fm_right_up.out;
+		
+		_vid_audio_limit(s, &s->fm_right, &s->fm_right_up, pulls, s->conf.a2stereo);
+		_audio_up_line(s, &s->fm_right_up, l->width, pulls);
+		
+		if(s->conf.a2stereo)
+		{
+			for(x = 0; x < l->width; x++)
 			{
 				int16_t s1[2] = { 0, 0 };
 				int16_t s2[2] = { 0, 0 };
@@ -3411,35 +3729,25 @@ static int _vid_audio_process(vid_t *s, void *arg, int nlines, vid_line_t **line
 				if(s->a2stereo_system_m)
 				{
 					/* The System M variant is L-R, not R */
-					a2 = s->fm_mono.sample - s->fm_right.sample;
+					a2[x] = s->fm_mono_up.out[x] - a2[x];
 				}
 				
 				/* Add the pilot tone */
 				_am_modulator_add(&s->a2stereo_signal, s1, 0);
 				_am_modulator_add(&s->a2stereo_pilot, s2, s1[0]);
-				a2 += s2[0];
+				a2[x] += s2[0];
 			}
-			
-			_fm_modulator_add(&s->fm_right, add, a2);
 		}
-		
-		if(s->conf.am_audio_level > 0 && s->conf.am_mono_carrier != 0)
-		{
-			_am_modulator_add(&s->am_mono, add, s->am_mono.sample);
-		}
-		
-		l->output[x * 2 + 0] += add[0];
-		l->output[x * 2 + 1] += add[1];
 	}
 	
-	if(s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0)
+	if(s->conf.am_audio_level > 0 && s->conf.am_mono_carrier != 0)
 	{
-		nicam_mod_output(&s->nicam, l->output, l->width);
+		_audio_up_line(s, &s->am_mono_up, l->width, pulls);
 	}
 	
-	if(s->conf.dance_level > 0 && s->conf.dance_carrier != 0)
+	if(s->ncarriers > 0)
 	{
-		dance_mod_output(&s->dance, l->output, l->width);
+		_vid_audio_mix(s, l->output, l->width);
 	}
 	
 	l->audio_len = fifo_read(&s->audio_reader, (void **) &l->audio, NICAM_AUDIO_LEN * 2 * 10 * sizeof(int16_t), 0);
@@ -3452,13 +3760,9 @@ static int _vid_audio_process(vid_t *s, void *arg, int nlines, vid_line_t **line
 static int _vid_fmmod_process(vid_t *s, void *arg, int nlines, vid_line_t **lines)
 {
 	vid_line_t *l = lines[0];
-	int x;
 	
 	/* FM modulate the video and audio if requested */
-	for(x = 0; x < l->width; x++)
-	{
-		_fm_modulator(&s->fm_video, &l->output[x * 2], l->output[x * 2]);
-	}
+	_fm_modulator_line(s, &s->fm_video, l->output, l->width);
 	
 	return(1);
 }
@@ -3482,35 +3786,33 @@ static int _vid_swap_iq_process(vid_t *s, void *arg, int nlines, vid_line_t **li
 static int _vid_offset_process(vid_t *s, void *arg, int nlines, vid_line_t **lines)
 {
 	vid_line_t *l = lines[0];
-	int x;
-	
-	for(x = 0; x < l->width; x++)
-	{
-		cint16_t a, b;
-		
-		cint32_mul(&s->offset.phase, &s->offset.phase, &s->offset.delta);
-		
-		a.i = l->output[x * 2 + 0];
-		a.q = l->output[x * 2 + 1];
-		b.i = s->offset.phase.i >> 16;
-		b.q = s->offset.phase.q >> 16;
-		cint16_mul(&a, &a, &b);
-		
-		l->output[x * 2 + 0] = a.i;
-		l->output[x * 2 + 1] = a.q;
-		
-		/* Correct the amplitude after INT16_MAX samples */
-		if(--s->offset.counter == 0)
+	int16_t *dst = l->output;
+	int16_t carrier[256 * 2];
+	uint32_t phase[256];
+	uint32_t p = s->offset.phase;
+	int samples, x, n;
+	
+	/* The carrier is generated a block at a time from a phase
+	 * accumulator, which runs continuously across lines and
+	 * does not drift, then mixed with the whole block at once.
+	 * Each output component is within 1.5 LSB of the exact
+	 * product, 1 LSB of that from truncating the multiply */
+	for(samples = l->width; samples > 0; samples -= n, dst += n * 2)
+	{
+		n = samples < 256 ? samples : 256;
+		
+		for(x = 0; x < n; x++)
 		{
-			double ra = atan2(s->offset.phase.q, s->offset.phase.i);
-			
-			s->offset.phase.i = lround(cos(ra) * INT32_MAX);
-			s->offset.phase.q = lround(sin(ra) * INT32_MAX);
-			
-			s->offset.counter = INT16_MAX;
+			p += s->offset.step;
+			phase[x] = p;
 		}
+		
+		s->nco_kernel(carrier, phase, s->offset.lut, n);
+		s->cmul_kernel(dst, carrier, n);
 	}
 	
+	s->offset.phase = p;
+	
 	return(1);
 }
 
@@ -3574,43 +3876,160 @@ static int _add_lineprocess(vid_t *s, const char *name, int nlines, int thread,
 		return(VID_OUT_OF_MEMORY);
 	}
 	
-	/* Update required line total */
-	s->olines += p->nlines - (p->thread || lp == NULL || lp->thread ? 0 : 1);
+	atomic_init(&p->step, 0);
+	atomic_init(&p->waiters, 0);
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	atomic_init(&p->process_ns, 0);
+	atomic_init(&p->wait_ns, 0);
+	atomic_init(&p->nlines_done, 0);
+	p->stats_process_ns = 0;
+	p->stats_wait_ns = 0;
+	p->stats_nlines = 0;
+	
+	/* Processes on different threads must not share lines. Each
+	 * advances block_lines lines per step, and the gap between them
+	 * holds LINE_QUEUE_DEPTH blocks so one can run ahead of the other */
+	if(lp == NULL)
+	{
+		p->spacing = 0;
+		p->depth = 0;
+		s->olines += p->nlines;
+	}
+	else if(p->thread || lp->thread)
+	{
+		p->depth = LINE_QUEUE_DEPTH;
+		p->spacing = p->nlines + s->block_lines * p->depth - 1;
+		s->olines += p->spacing;
+	}
+	else
+	{
+		p->depth = 0;
+		p->spacing = p->nlines - 1;
+		s->olines += p->spacing;
+	}
 	
 	return(VID_OK);
 }
 
-static void *_lineprocess_thread(void *priv)
+static uint64_t _clock_ns(void)
 {
-	_lineprocess_t *p = priv;
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void _stats_add(atomic_uint_least64_t *v, uint64_t n)
+{
+	/* Statistics have a single writer, so a
+	 * relaxed load and store is sufficient */
+	atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static int _lineprocess_ready(_lineprocess_t *p, unsigned int step)
+{
+	/* Test if process p has completed at least step blocks. The
+	 * difference is signed so the counters are free to wrap */
+	return((int) (atomic_load(&p->step) - step) >= 0);
+}
+
+static int _lineprocess_wait(_lineprocess_t *p)
+{
+	_lineprocess_t *up = p - 1;
+	unsigned int step;
+	uint64_t t;
 	int i;
 	
-	fprintf(stderr, "%s: Thread started\n", p->name);
+	/* Wait until the previous process is far enough ahead for
+	 * this one to begin its next block. Returns 0 when ready,
+	 * or -1 if the line process threads are stopping */
 	
-	while(p->vid->thread_abort == 0)
+	step = atomic_load(&p->step) + 1 - p->depth;
+	
+	if(_lineprocess_ready(up, step))
 	{
-		if(p->process) p->process(p->vid, p->arg, p->nlines, p->lines);
+		return(0);
+	}
+	
+	t = _clock_ns();
+	
+	/* Poll for a short time before sleeping */
+	for(i = 0; i < LINE_QUEUE_SPIN && !_lineprocess_ready(up, step); i++);
+	
+	if(i == LINE_QUEUE_SPIN)
+	{
+		atomic_fetch_add(&up->waiters, 1);
 		
-		pthread_barrier_wait(&p->vid->process_barrier);
+		pthread_mutex_lock(&up->mutex);
 		
-		for(i = 0; i < p->nlines; i++)
+		while(!_lineprocess_ready(up, step) && p->vid->thread_abort == 0)
 		{
-			p->lines[i] = p->lines[i]->next;
+			pthread_cond_wait(&up->cond, &up->mutex);
 		}
+		
+		pthread_mutex_unlock(&up->mutex);
+		
+		atomic_fetch_sub(&up->waiters, 1);
 	}
 	
-	fprintf(stderr, "%s: Thread ending\n", p->name);
+	_stats_add(&p->wait_ns, _clock_ns() - t);
+	
+	return(p->vid->thread_abort == 0 ? 0 : -1);
+}
+
+static void _lineprocess_wake(_lineprocess_t *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+static void _lineprocess_done(_lineprocess_t *p)
+{
+	/* Publish the completed block, waking the next
+	 * process if it has gone to sleep waiting for it */
+	atomic_fetch_add(&p->step, 1);
+	
+	if(atomic_load(&p->waiters) > 0)
+	{
+		_lineprocess_wake(p);
+	}
+}
+
+static void *_lineprocess_thread(void *priv)
+{
+	_lineprocess_t *p = priv;
+	int i, j;
 	
-	/* Ensure all lineprocess theads exit at the same moment,
-	 * or some could block forever at pthread_barrier_wait() */
+	fprintf(stderr, "%s: Thread started\n", p->name);
 	
-	p->vid->nthreads--;
+	/* A threaded process is never the first, so there is always a
+	 * previous process (p - 1) to wait on */
 	
-	do
+	while(_lineprocess_wait(p) == 0)
 	{
-		pthread_barrier_wait(&p->vid->process_barrier);
+		uint64_t t = p->vid->conf.stats ? _clock_ns() : 0;
+		
+		for(j = 0; j < p->vid->block_lines; j++)
+		{
+			if(p->process) p->process(p->vid, p->arg, p->nlines, p->lines);
+			
+			for(i = 0; i < p->nlines; i++)
+			{
+				p->lines[i] = p->lines[i]->next;
+			}
+		}
+		
+		if(p->vid->conf.stats)
+		{
+			_stats_add(&p->process_ns, _clock_ns() - t);
+			_stats_add(&p->nlines_done, p->vid->block_lines);
+		}
+		
+		_lineprocess_done(p);
 	}
-	while(p->vid->nthreads > 0);
 	
 	fprintf(stderr, "%s: Thread ended\n", p->name);
 	
@@ -3838,6 +4257,11 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 	s->sample_rate = sample_rate;
 	s->pixel_rate = pixel_rate ? pixel_rate : sample_rate;
 	
+	s->block_lines = s->conf.block_lines > 0 ? s->conf.block_lines : 1;
+	
+	/* Select the active video kernels for this CPU */
+	vid_simd_init(s);
+	
 	_test_sample_rate(&s->conf, s->pixel_rate);
 	
 	/* Calculate the number of samples per line */
@@ -3894,12 +4318,11 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 		return(VID_OUT_OF_MEMORY);
 	}
 	
-	/* Allocate memory for YUV lookup tables */
-	s->yuv_level_lookup = malloc(0x1000000 * sizeof(_yuv16_t));
-	if(s->yuv_level_lookup == NULL)
+	/* Decode the line sequence for each line */
+	r = _init_line_desc(s);
+	if(r != VID_OK)
 	{
-		vid_free(s);
-		return(VID_OUT_OF_MEMORY);
+		return(r);
 	}
 	
 	/* Generate the gamma lookup table. LUTception */
@@ -3908,54 +4331,58 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 		glut[c] = pow((double) c / 255, 1 / s->conf.gamma);
 	}
 	
-	/* Generate the RGB > signal level lookup tables */
-	for(c = 0x000000; c <= 0xFFFFFF; c++)
+	/* Generate the RGB > signal level lookup tables. Y, U and V are
+	 * linear in the gamma corrected R, G and B values, so each channel
+	 * has its own table and the results are summed per pixel */
+	for(r = 0; r < 3; r++)
 	{
-		double r, g, b;
-		double y, u, v;
-		
-		/* Calculate RGB 0..1 values */
-		r = glut[(c & 0xFF0000) >> 16];
-		g = glut[(c & 0x00FF00) >> 8];
-		b = glut[(c & 0x0000FF) >> 0];
+		const double w[3] = { s->conf.rw_co, s->conf.gw_co, s->conf.bw_co };
 		
-		/* Calculate Y, Cb and Cr values */
-		y = r * s->conf.rw_co
-		  + g * s->conf.gw_co
-		  + b * s->conf.bw_co;
-		u = (b - y) * s->conf.eu_co;
-		v = (r - y) * s->conf.ev_co;
-		
-		/* Limit magnitude of D/D2-MAC chrominance to -0.5 >= 0.5 */
-		if(s->conf.type == VID_MAC)
+		for(c = 0; c < 0x100; c++)
 		{
-			d = fabs(u) > fabs(v) ? fabs(u) : fabs(v);
-			if(d > 0.5)
+			double y, u, v;
+			
+			/* Calculate this channels part of the Y, Cb and Cr values */
+			y = glut[c] * w[r];
+			u = ((r == 2 ? glut[c] : 0) - y) * s->conf.eu_co;
+			v = ((r == 0 ? glut[c] : 0) - y) * s->conf.ev_co;
+			
+			/* Adjust values to correct signal level, the
+			 * offsets are included in the red channel */
+			y *= (s->conf.white_level - s->conf.black_level) * level;
+			if(r == 0) y += s->conf.black_level * level;
+			
+			if(s->conf.colour_mode != VID_SECAM)
 			{
-				d = 0.5 / d;
-				u *= d;
-				v *= d;
+				u *= (s->conf.white_level - s->conf.black_level) * level;
+				v *= (s->conf.white_level - s->conf.black_level) * level;
 			}
+			else
+			{
+				if(r == 0)
+				{
+					u += SECAM_CB_FREQ - SECAM_FM_FREQ;
+					v += SECAM_CR_FREQ - SECAM_FM_FREQ;
+				}
+				
+				u /= SECAM_FM_DEV;
+				v /= SECAM_FM_DEV;
+			}
+			
+			/* Convert to fixed point INT16 range */
+			d = INT16_MAX * (double) (1 << VID_YUV_SHIFT);
+			s->yuv_level_lookup[r][c].y = round(y * d);
+			s->yuv_level_lookup[r][c].u = round(u * d);
+			s->yuv_level_lookup[r][c].v = round(v * d);
 		}
-		
-		/* Adjust values to correct signal level */
-		y = (s->conf.black_level + (y * (s->conf.white_level - s->conf.black_level))) * level;
-		
-		if(s->conf.colour_mode != VID_SECAM)
-		{
-			u *= (s->conf.white_level - s->conf.black_level) * level;
-			v *= (s->conf.white_level - s->conf.black_level) * level;
-		}
-		else
-		{
-			u = (u + SECAM_CB_FREQ - SECAM_FM_FREQ) / SECAM_FM_DEV;
-			v = (v + SECAM_CR_FREQ - SECAM_FM_FREQ) / SECAM_FM_DEV;
-		}
-		
-		/* Convert to INT16 range and store in tables */
-		s->yuv_level_lookup[c].y = round(_dlimit(y, -1, 1) * INT16_MAX);
-		s->yuv_level_lookup[c].u = round(_dlimit(u, -1, 1) * INT16_MAX);
-		s->yuv_level_lookup[c].v = round(_dlimit(v, -1, 1) * INT16_MAX);
+	}
+	
+	/* Limit magnitude of D/D2-MAC chrominance to -0.5 >= 0.5 */
+	s->yuv_mac_limit = 0;
+	
+	if(s->conf.type == VID_MAC)
+	{
+		s->yuv_mac_limit = round(fabs(0.5 * (s->conf.white_level - s->conf.black_level) * level) * INT16_MAX * (1 << VID_YUV_SHIFT));
 	}
 	
 	if(s->conf.colour_mode == VID_PAL ||
@@ -4151,14 +4578,21 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 			return(VID_OUT_OF_MEMORY);
 		}
 		
-		/* Allocate memory for the chrominance baseband buffer,
-		 * the top half is used for the vertical averaging filter */
+		/* Allocate memory for the chrominance baseband buffer */
 		s->chrominance_buffer = malloc(sizeof(int16_t) * 2 * s->width);
 		if(!s->chrominance_buffer)
 		{
 			vid_free(s);
 			return(VID_OUT_OF_MEMORY);
 		}
+		
+		/* And the previous line, used for the vertical averaging filter */
+		s->secam_prev = malloc(sizeof(int16_t) * s->width);
+		if(!s->secam_prev)
+		{
+			vid_free(s);
+			return(VID_OUT_OF_MEMORY);
+		}
 	}
 	
 	/* Set the next line/frame counter */
@@ -4203,7 +4637,20 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 	}
 	else
 	{
-		_add_lineprocess(s, "raster", 3, 0, NULL, _vid_next_line_raster, NULL);
+		vid_lineprocess_process_t raster;
+		
+		/* Select the raster renderer for this colour mode */
+		switch(s->conf.colour_mode)
+		{
+		case VID_PAL:        raster = _vid_next_line_raster_pal; break;
+		case VID_NTSC:       raster = _vid_next_line_raster_ntsc; break;
+		case VID_SECAM:      raster = _vid_next_line_raster_secam; break;
+		case VID_APOLLO_FSC: raster = _vid_next_line_raster_apollo_fsc; break;
+		case VID_CBS_FSC:    raster = _vid_next_line_raster_cbs_fsc; break;
+		default:             raster = _vid_next_line_raster_mono; break;
+		}
+		
+		_add_lineprocess(s, "raster", 3, 0, NULL, raster, NULL);
 		
 		if(s->conf.colour_mode == VID_SECAM)
 		{
@@ -4410,6 +4857,13 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 			return(r);
 		}
 		
+		r = _init_audio_up(s, &s->fm_mono_up);
+		if(r != VID_OK)
+		{
+			vid_free(s);
+			return(r);
+		}
+		
 		if(s->conf.fm_mono_preemph)
 		{
 			const double *taps = NULL;
@@ -4449,6 +4903,13 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 			return(r);
 		}
 		
+		r = _init_audio_up(s, &s->fm_left_up);
+		if(r != VID_OK)
+		{
+			vid_free(s);
+			return(r);
+		}
+		
 		if(s->conf.fm_left_preemph)
 		{
 			const double *taps = NULL;
@@ -4488,6 +4949,13 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 			return(r);
 		}
 		
+		r = _init_audio_up(s, &s->fm_right_up);
+		if(r != VID_OK)
+		{
+			vid_free(s);
+			return(r);
+		}
+		
 		if(s->conf.fm_right_preemph)
 		{
 			const double *taps = NULL;
@@ -4555,6 +5023,46 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 			vid_free(s);
 			return(r);
 		}
+		
+		r = _init_audio_up(s, &s->am_mono_up);
+		if(r != VID_OK)
+		{
+			vid_free(s);
+			return(r);
+		}
+	}
+	
+	/* Register the active audio carriers with the mixer */
+	s->ncarriers = 0;
+	
+	if(s->conf.fm_mono_level > 0 && s->conf.fm_mono_carrier != 0)
+	{
+		_add_carrier(s, _fm_carrier_process, &s->fm_mono, s->fm_mono_up.out);
+	}
+	
+	if(s->conf.fm_left_level > 0 && s->conf.fm_left_carrier != 0)
+	{
+		_add_carrier(s, _fm_carrier_process, &s->fm_left, s->fm_left_up.out);
+	}
+	
+	if(s->conf.fm_right_level > 0 && s->conf.fm_right_carrier != 0)
+	{
+		_add_carrier(s, _fm_carrier_process, &s->fm_right, s->fm_right_up.out);
+	}
+	
+	if(s->conf.am_audio_level > 0 && s->conf.am_mono_carrier != 0)
+	{
+		_add_carrier(s, _am_carrier_process, &s->am_mono, s->am_mono_up.out);
+	}
+	
+	if(s->conf.nicam_level > 0 && s->conf.nicam_carrier != 0)
+	{
+		_add_carrier(s, _nicam_carrier_process, &s->nicam, NULL);
+	}
+	
+	if(s->conf.dance_level > 0 && s->conf.dance_carrier != 0)
+	{
+		_add_carrier(s, _dance_carrier_process, &s->dance, NULL);
 	}
 	
 	/* Add the audio process */
@@ -4591,15 +5099,13 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 	
 	if(s->conf.offset != 0)
 	{
-		double d;
-		
-		s->offset.counter = INT16_MAX;
-		s->offset.phase.i = INT16_MAX;
-		s->offset.phase.q = 0;
-		
-		d = 2.0 * M_PI / s->sample_rate * s->conf.offset;
-		s->offset.delta.i = lround(cos(d) * INT32_MAX);
-		s->offset.delta.q = lround(sin(d) * INT32_MAX);
+		/* The offset carrier uses the FM modulator's NCO */
+		r = _init_fm_modulator(&s->offset, s->sample_rate, s->conf.offset, 0, 1.0);
+		if(r != VID_OK)
+		{
+			vid_free(s);
+			return(r);
+		}
 		
 		_add_lineprocess(s, "offset", 1, 1, NULL, _vid_offset_process, NULL);
 	}
@@ -4638,6 +5144,10 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 	_add_lineprocess(s, "output", 1, 0, NULL, NULL, NULL);
 	s->output_process = &s->processes[s->nprocesses - 1];
 	
+	/* The lines of a block must remain valid until they have all been
+	 * returned, while the first process wraps around the buffer */
+	s->olines += s->block_lines - 1;
+	
 	/* Output line buffer(s) */
 	s->oline = calloc(sizeof(vid_line_t), s->olines);
 	if(!s->oline)
@@ -4672,6 +5182,17 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 		s->oline[r].audio_len = 0;
 	}
 	
+	/* Output block */
+	s->block = calloc(sizeof(vid_line_t *), s->block_lines);
+	if(!s->block)
+	{
+		vid_free(s);
+		return(VID_OUT_OF_MEMORY);
+	}
+	
+	s->block_len = 0;
+	s->block_pos = 0;
+	
 	/* Setup lineprocess output windows */
 	l = &s->oline[s->olines - 1];
 	
@@ -4679,7 +5200,7 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 	{
 		_lineprocess_t *p = &s->processes[r];
 		
-		l -= p->nlines - ((r > 0 && s->processes[r - 1].thread) || p->thread ? 0 : 1);
+		l -= (r > 0 ? p->spacing : p->nlines - 1);
 		
 		for(x = 0; x < p->nlines; x++)
 		{
@@ -4687,11 +5208,9 @@ int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const
 		}
 	}
 	
-	/* Init thread barrier */
+	/* Start threaded processes */
 	s->thread_abort = 0;
-	pthread_barrier_init(&s->process_barrier, NULL, s->nthreads + 1);
 	
-	/* Start threaded processes */
 	for(r = 0; r < s->nprocesses; r++)
 	{
 		if(s->processes[r].thread)
@@ -4707,39 +5226,50 @@ void vid_free(vid_t *s)
 {
 	int i;
 	
-	/* Close the AV source */
-	av_close(&s->av);
-	
 	/* Wait for threads to end */
 	if(s->thread_abort == 0)
 	{
 		s->thread_abort = 1;
 		
-		while(s->nthreads > 0)
+		/* Release the audio process if it is waiting on the source */
+		av_abort(&s->av);
+		
+		/* Wake any threads waiting on another process */
+		for(i = 0; i < s->nprocesses; i++)
 		{
-			pthread_barrier_wait(&s->process_barrier);
+			_lineprocess_wake(&s->processes[i]);
 		}
 		
+		/* All threads must end before any process is freed, as
+		 * one may still be waiting on the previous process */
 		for(i = 0; i < s->nprocesses; i++)
 		{
 			if(s->processes[i].thread == 1)
 			{
 				pthread_join(s->processes[i].pthread, NULL);
 			}
-			
+		}
+		
+		for(i = 0; i < s->nprocesses; i++)
+		{
 			if(s->processes[i].free)
 			{
 				s->processes[i].free(s, s->processes[i].arg);
 			}
 			
 			free(s->processes[i].lines);
+			
+			pthread_cond_destroy(&s->processes[i].cond);
+			pthread_mutex_destroy(&s->processes[i].mutex);
 		}
 		
 		free(s->processes);
-		
-		pthread_barrier_destroy(&s->process_barrier);
 	}
 	
+	/* Close the AV source. This is done once the threads have
+	 * ended as the audio process may still be reading from it */
+	av_close(&s->av);
+	
 	if(s->conf.passthru)
 	{
 		fclose(s->passthru);
@@ -4805,7 +5335,6 @@ void vid_free(vid_t *s)
 	fifo_free(&s->audiofifo);
 	
 	/* Free allocated memory */
-	free(s->yuv_level_lookup);
 	free(s->colour_lookup);
 	fir_int16_free(&s->secam_l_fir);
 	fir_int16_free(&s->fm_secam_fir);
@@ -4815,6 +5344,7 @@ void vid_free(vid_t *s)
 	_free_fm_modulator(&s->fm_mono);
 	_free_fm_modulator(&s->fm_left);
 	_free_fm_modulator(&s->fm_right);
+	_free_fm_modulator(&s->offset);
 	_free_am_modulator(&s->a2stereo_pilot);
 	_free_am_modulator(&s->a2stereo_signal);
 	limiter_free(&s->fm_mono.limiter);
@@ -4823,6 +5353,11 @@ void vid_free(vid_t *s)
 	dance_mod_free(&s->dance);
 	nicam_mod_free(&s->nicam);
 	_free_am_modulator(&s->am_mono);
+	_free_audio_up(&s->fm_mono_up);
+	_free_audio_up(&s->fm_left_up);
+	_free_audio_up(&s->fm_right_up);
+	_free_audio_up(&s->am_mono_up);
+	free(s->audio_pos);
 	
 	if(s->oline)
 	{
@@ -4833,11 +5368,15 @@ void vid_free(vid_t *s)
 		free(s->oline);
 	}
 	
+	free(s->block);
+	
 	fir_int16_free(&s->chrominance_fir);
 	
 	free(s->chrominance_buffer);
+	free(s->secam_prev);
 	free(s->burst_win);
 	free(s->syncs);
+	free(s->line_desc);
 	free(s->fsc_syncs);
 	
 	memset(s, 0, sizeof(vid_t));
@@ -4864,73 +5403,200 @@ size_t vid_get_framebuffer_length(vid_t *s)
 	return(sizeof(uint32_t) * s->active_width * s->conf.active_lines);
 }
 
-static vid_line_t *_vid_next_line(vid_t *s)
+static void _vid_print_stats(vid_t *s, int lines)
 {
-	vid_line_t *l = s->output_process->lines[0];
-	int i, j;
+	double budget;
+	int i;
+	
+	/* Only run this after at least 1 second of lines */
+	s->stats_counter += (int64_t) lines * s->conf.frame_rate.den;
+	if(s->stats_counter < (int64_t) s->conf.lines * s->conf.frame_rate.num) return;
 	
-	/* Load the next frame */
-	if(s->bline == 1 || (s->conf.interlace && s->bline == s->conf.hline))
+	s->stats_counter -= (int64_t) s->conf.lines * s->conf.frame_rate.num;
+	s->stats_seconds++;
+	
+	/* The real-time budget for each line, in nanoseconds */
+	budget = 1e9 * s->conf.frame_rate.den / s->conf.frame_rate.num / s->conf.lines;
+	
+	if(s->conf.stats == VID_STATS_JSON)
 	{
-		/* Have we reached the end of the video? */
-		if(av_eof(&s->av))
+		fprintf(stderr, "{\"time\":%d,\"line_budget_ns\":%.1f,\"processes\":[", s->stats_seconds, budget);
+	}
+	else
+	{
+		fprintf(stderr, "%-16s %7s %10s %10s %8s\n", "process", "thread", "ns/line", "wait/line", "budget");
+	}
+	
+	for(i = 0; i < s->nprocesses; i++)
+	{
+		_lineprocess_t *p = &s->processes[i];
+		uint64_t pns = atomic_load_explicit(&p->process_ns, memory_order_relaxed);
+		uint64_t wns = atomic_load_explicit(&p->wait_ns, memory_order_relaxed);
+		uint64_t n = atomic_load_explicit(&p->nlines_done, memory_order_relaxed);
+		double pline = 0, wline = 0;
+		
+		if(n > p->stats_nlines)
 		{
-			return(NULL);
+			pline = (double) (pns - p->stats_process_ns) / (n - p->stats_nlines);
+			wline = (double) (wns - p->stats_wait_ns) / (n - p->stats_nlines);
 		}
 		
-		av_read_video(&s->av, &s->vframe);
-		
-		av_rotate_frame(&s->vframe, s->conf.frame_orientation & 3);
-		if(s->conf.frame_orientation & VID_HFLIP) av_hflip_frame(&s->vframe);
-		if(s->conf.frame_orientation & VID_VFLIP) av_vflip_frame(&s->vframe);
-		
-		/* Crop frame to fit inside active video area */
-		av_crop_frame(&s->vframe,
-			(s->vframe.width - s->active_width) / 2,
-			(s->vframe.height - s->conf.active_lines) / 2,
-			s->active_width,
-			s->conf.active_lines
-		);
-		
-		/* Calculate frame offset from top left */
-		s->vframe_x = (s->active_width - s->vframe.width) / 2;
-		s->vframe_y = (s->conf.active_lines - s->vframe.height) / 2;
+		p->stats_process_ns = pns;
+		p->stats_wait_ns = wns;
+		p->stats_nlines = n;
 		
-		/* Extract CC608 subtitles */
-		if(s->conf.cc608)
+		if(s->conf.stats == VID_STATS_JSON)
 		{
-			cc608_fifo_write(&s->cc608.ccfifo, s->vframe.cc608, 2);
+			fprintf(stderr, "%s{\"name\":\"%s\",\"thread\":%d,\"ns_per_line\":%.1f,\"wait_ns_per_line\":%.1f,\"budget\":%.2f}",
+				i > 0 ? "," : "", p->name, p->thread, pline, wline, pline / budget * 100
+			);
+		}
+		else
+		{
+			fprintf(stderr, "%-16s %7s %10.1f %10.1f %7.2f%%\n",
+				p->name, p->thread ? "yes" : "main", pline, wline, pline / budget * 100
+			);
 		}
 	}
 	
-	for(i = 0; i < s->nprocesses; i++)
+	if(s->conf.stats == VID_STATS_JSON)
 	{
-		_lineprocess_t *p = &s->processes[i];
-		
-		if(p->thread == 0)
+		fprintf(stderr, "]}\n");
+	}
+}
+
+static vid_line_t *_vid_next_line(vid_t *s)
+{
+	int i, j, k;
+	
+	/* Return any remaining lines from the last block */
+	if(s->block_pos < s->block_len)
+	{
+		return(s->block[s->block_pos++]);
+	}
+	
+	/* Report an EOF that occurred part way through the last block */
+	if(s->block_eof)
+	{
+		s->block_eof = 0;
+		return(NULL);
+	}
+	
+	s->block_len = 0;
+	s->block_pos = 0;
+	
+	/* Wait for any threaded processes feeding the main thread */
+	for(i = 1; i < s->nprocesses; i++)
+	{
+		if(s->processes[i].thread == 0 && s->processes[i].depth > 0)
+		{
+			_lineprocess_wait(&s->processes[i]);
+		}
+	}
+	
+	for(k = 0; k < s->block_lines; k++)
+	{
+		/* Load the next frame */
+		if(s->bline == 1 || (s->conf.interlace && s->bline == s->conf.hline) ||
+		   (k == 0 && s->vframe_reload))
 		{
-			if(p->process)
+			/* Have we reached the end of the video? */
+			if(av_eof(&s->av))
 			{
-				p->process(p->vid, p->arg, p->nlines, p->lines);
+				if(k == 0)
+				{
+					return(NULL);
+				}
+				
+				/* Every process must advance by a full block, so the
+				 * remaining lines are rendered from a blank frame. The
+				 * EOF is reported once they have been returned, and the
+				 * next source is loaded immediately after that */
+				s->block_eof = 1;
+				s->vframe_reload = 1;
 			}
+			else
+			{
+				s->vframe_reload = 0;
+			}
+			
+			av_read_video(&s->av, &s->vframe);
+			
+			av_rotate_frame(&s->vframe, s->conf.frame_orientation & 3);
+			if(s->conf.frame_orientation & VID_HFLIP) av_hflip_frame(&s->vframe);
+			if(s->conf.frame_orientation & VID_VFLIP) av_vflip_frame(&s->vframe);
 			
-			for(j = 0; j < p->nlines; j++)
+			/* Crop frame to fit inside active video area */
+			av_crop_frame(&s->vframe,
+				(s->vframe.width - s->active_width) / 2,
+				(s->vframe.height - s->conf.active_lines) / 2,
+				s->active_width,
+				s->conf.active_lines
+			);
+			
+			/* Calculate frame offset from top left */
+			s->vframe_x = (s->active_width - s->vframe.width) / 2;
+			s->vframe_y = (s->conf.active_lines - s->vframe.height) / 2;
+			
+			/* Extract CC608 subtitles */
+			if(s->conf.cc608)
 			{
-				p->lines[j] = p->lines[j]->next;
+				cc608_fifo_write(&s->cc608.ccfifo, s->vframe.cc608, 2);
 			}
 		}
+		
+		s->block[s->block_len++] = s->output_process->lines[0];
+		
+		for(i = 0; i < s->nprocesses; i++)
+		{
+			_lineprocess_t *p = &s->processes[i];
+			
+			if(p->thread == 0)
+			{
+				uint64_t t = s->conf.stats ? _clock_ns() : 0;
+				
+				if(p->process)
+				{
+					p->process(p->vid, p->arg, p->nlines, p->lines);
+				}
+				
+				for(j = 0; j < p->nlines; j++)
+				{
+					p->lines[j] = p->lines[j]->next;
+				}
+				
+				if(s->conf.stats)
+				{
+					_stats_add(&p->process_ns, _clock_ns() - t);
+					_stats_add(&p->nlines_done, 1);
+				}
+			}
+		}
+		
+		/* Advance the next line/frame counter */
+		if(s->bline++ == s->conf.lines)
+		{
+			s->bline = 1;
+			s->bframe++;
+		}
 	}
 	
-	pthread_barrier_wait(&s->process_barrier);
+	/* Release the block to the threaded processes */
+	for(i = 0; i < s->nprocesses; i++)
+	{
+		if(s->processes[i].thread == 0)
+		{
+			_lineprocess_done(&s->processes[i]);
+		}
+	}
 	
-	/* Advance the next line/frame counter */
-	if(s->bline++ == s->conf.lines)
+	/* Report pipeline stats every ~1 second */
+	if(s->conf.stats == VID_STATS_TEXT || s->conf.stats == VID_STATS_JSON)
 	{
-		s->bline = 1;
-		s->bframe++;
+		_vid_print_stats(s, s->block_len);
 	}
 	
-	return(l);
+	return(s->block[s->block_pos++]);
 }
 
 vid_line_t *vid_next_line(vid_t *s)
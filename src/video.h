@@ -19,6 +19,8 @@
 #define _VIDEO_H
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 #include "av.h"
 #include "nicam728.h"
 #include "dance.h"
@@ -40,6 +42,7 @@ typedef struct vid_t vid_t;
 #include "cc608.h"
 #include "vbidata.h"
 #include "sis.h"
+#include "video_simd.h"
 
 /* Return codes */
 #define VID_OK             0
@@ -86,16 +89,36 @@ typedef struct vid_t vid_t;
 #define VID_75US 2
 #define VID_J17  3
 
+/* Pipeline statistics output */
+#define VID_STATS_NONE 0
+#define VID_STATS_TEXT 1
+#define VID_STATS_JSON 2
+#define VID_STATS_QUIET 3 /* Collected but not printed */
+
 /* RF modulation */
 
+/* Length of the quarter-wave table used by the FM modulator */
+#define FM_NCO_QUARTER_BITS 10
+#define FM_NCO_QUARTER      (1 << FM_NCO_QUARTER_BITS)
+
+/* Fractional bits of the derivative terms in the table */
+#define FM_NCO_DSHIFT 9
+
 typedef struct {
 	int16_t level;
-	int32_t counter;
-	cint32_t phase;
-	cint32_t *lut;
+	
+	/* Phase accumulator, a full turn is 2^32 */
+	uint32_t phase;
+	uint32_t step;
+	uint32_t dev_hi;
+	uint32_t dev_lo;
+	
+	/* Quarter-wave cosine and sine table, scaled by level. Each
+	 * step has two entries, the cosine and sine at the start of
+	 * the step and the same multiplied by the step in radians */
+	cint16_t *lut;
 	
 	limiter_t limiter;
-	int16_t sample;
 	
 	/* FM energy dispersal */
 	div_t ed_delta;
@@ -110,15 +133,18 @@ typedef struct {
 	cint32_t phase;
 	cint32_t delta;
 	
-	int16_t sample;
-	
 } _mod_am_t;
 
+/* The 32 kHz audio is upsampled by VID_AUDIO_UP with a polyphase
+ * filter, then linearly interpolated to the output sample rate */
+#define VID_AUDIO_UP 16
+
 typedef struct {
-	int32_t counter;
-	cint32_t phase;
-	cint32_t delta;
-} _mod_offset_t;
+	fir_int16_t fir;
+	int16_t *in;
+	int16_t *ov;
+	int16_t *out;
+} _audio_up_t;
 
 
 
@@ -289,6 +315,12 @@ typedef struct {
 	/* Video filter enable flag */
 	int vfilter;
 	
+	/* Number of lines each line process handles per pipeline step */
+	int block_lines;
+	
+	/* Print pipeline statistics once per second */
+	int stats;
+	
 } vid_config_t;
 
 typedef struct {
@@ -303,6 +335,15 @@ typedef struct {
 	int16_t v;
 } _yuv16_t;
 
+typedef struct {
+	int32_t y;
+	int32_t u;
+	int32_t v;
+} _yuv32_t;
+
+/* Fractional bits of the RGB > signal level lookup tables */
+#define VID_YUV_SHIFT 12
+
 struct vid_line_t {
 	
 	/* The output line buffer */
@@ -328,6 +369,29 @@ struct vid_line_t {
 	vid_line_t *next;
 };
 
+/* Line descriptor, decoded once from the line sequence codes */
+typedef struct {
+	uint8_t sync;	/* Sync pulses, one bit for each pulse in syncs */
+	uint8_t burst;	/* 1 if the line has a colour burst */
+	uint8_t active;	/* Active video, bit 0 = left half, bit 1 = right half */
+	int16_t vy;	/* Active video line, or -1 */
+	int al;		/* Active video region, if any */
+	int ar;
+} _vid_line_desc_t;
+
+/* Audio carrier generator. Writes the next samples of the carrier as
+ * interleaved I/Q, taking any audio input from src */
+typedef void (*vid_carrier_process_t)(vid_t *s, void *arg, const int16_t *src, int16_t *dst, int samples);
+
+typedef struct {
+	vid_carrier_process_t process;
+	void *arg;
+	const int16_t *src; /* Upsampled audio line, or NULL */
+} _vid_carrier_t;
+
+/* FM mono, left and right, AM, NICAM and DANCE */
+#define VID_MAX_CARRIERS 6
+
 /* Line process function prototypes */
 typedef int (*vid_lineprocess_process_t)(vid_t *s, void *arg, int nlines, vid_line_t **lines);
 typedef void (*vid_lineprocess_free_t)(vid_t *s, void *arg);
@@ -353,6 +417,31 @@ struct _lineprocess_t {
 	/* Thread handle */
 	int thread; /* 0 = Main thread, 1 = Separate thread */
 	pthread_t pthread;
+	
+	/* Lines between this window and the previous process */
+	int spacing;
+	
+	/* Number of blocks completed by this process. Block n can
+	 * begin once the previous process has completed n + 1 - depth
+	 * blocks. depth is 0 when both share the main thread */
+	atomic_uint step;
+	int depth;
+	
+	/* Used to sleep when the next process is waiting for this one */
+	atomic_int waiters;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	
+	/* Statistics: time spent processing lines and waiting on the
+	 * previous process, in nanoseconds, and the number of lines */
+	atomic_uint_least64_t process_ns;
+	atomic_uint_least64_t wait_ns;
+	atomic_uint_least64_t nlines_done;
+	
+	/* Totals at the last statistics report */
+	uint64_t stats_process_ns;
+	uint64_t stats_wait_ns;
+	uint64_t stats_nlines;
 };
 
 struct vid_t {
@@ -374,12 +463,22 @@ struct vid_t {
 	
 	vbidata_lut_t *syncs;
 	
+	/* Line descriptors for even and odd frames */
+	_vid_line_desc_t *line_desc;
+	
 	int16_t white_level;
 	int16_t black_level;
 	int16_t blanking_level;
 	int16_t sync_level;
 	
-	_yuv16_t *yuv_level_lookup;
+	_yuv32_t yuv_level_lookup[3][0x100];
+	int32_t yuv_mac_limit;
+	
+	/* Active video kernels */
+	vid_rgb_kernel_t rgb_kernel;
+	vid_mix_kernel_t mix_kernel;
+	vid_nco_kernel_t nco_kernel;
+	vid_cmul_kernel_t cmul_kernel;
 	
 	unsigned int colour_lookup_width;
 	unsigned int colour_lookup_offset;
@@ -399,6 +498,7 @@ struct vid_t {
 	cint16_t *fm_secam_bell;
 	int16_t secam_fsync_level;
 	int secam_field_id_lines;
+	int16_t *secam_prev;
 	
 	vbidata_lut_t *fsc_syncs;
 	
@@ -453,11 +553,15 @@ struct vid_t {
 	int16_t *audiobuffer;
 	size_t audiobuffer_samples;
 	int interp;
+	uint32_t *audio_pos;
 	
 	/* FM Mono/Stereo audio state */
 	_mod_fm_t fm_mono;
 	_mod_fm_t fm_left;
 	_mod_fm_t fm_right;
+	_audio_up_t fm_mono_up;
+	_audio_up_t fm_left_up;
+	_audio_up_t fm_right_up;
 	
 	/* Zweikanalton / A2 Stereo state */
 	int a2stereo_system_m;
@@ -479,12 +583,17 @@ struct vid_t {
 	
 	/* AM Mono audio state */
 	_mod_am_t am_mono;
+	_audio_up_t am_mono_up;
+	
+	/* Active audio carriers, summed by the audio mixer */
+	_vid_carrier_t carriers[VID_MAX_CARRIERS];
+	int ncarriers;
 	
 	/* FM Video state */
 	_mod_fm_t fm_video;
 	
 	/* Offset signal */
-	_mod_offset_t offset;
+	_mod_fm_t offset;
 	
 	/* Passthru source */
 	FILE *passthru;
@@ -498,17 +607,93 @@ struct vid_t {
 	vid_line_t *oline;
 	int max_width;
 	
+	/* Block of lines rendered by the last pipeline step */
+	int block_lines;
+	vid_line_t **block;
+	int block_len;
+	int block_pos;
+	int block_eof;
+	int vframe_reload;
+	
+	/* Statistics */
+	int64_t stats_counter;
+	int stats_seconds;
+	
 	/* Line processes */
 	int nprocesses;
 	int nthreads;
-	int thread_abort;
+	volatile int thread_abort;
 	_lineprocess_t *processes;
 	_lineprocess_t *output_process;
-	pthread_barrier_t process_barrier;
 };
 
 extern const vid_configs_t vid_configs[];
 
+static inline int16_t _vid_yuv_limit(int32_t v)
+{
+	/* Round half away from zero, as round() does */
+	v = v < 0 ? -((-v + (1 << (VID_YUV_SHIFT - 1))) >> VID_YUV_SHIFT)
+	          :  ((v + (1 << (VID_YUV_SHIFT - 1))) >> VID_YUV_SHIFT);
+	return(v < -INT16_MAX ? -INT16_MAX : (v > INT16_MAX ? INT16_MAX : v));
+}
+
+/* Convert an RGB colour to Y, U and V signal levels */
+static inline _yuv16_t vid_rgb_to_yuv(const vid_t *s, uint32_t rgb)
+{
+	const _yuv32_t *r = &s->yuv_level_lookup[0][(rgb >> 16) & 0xFF];
+	const _yuv32_t *g = &s->yuv_level_lookup[1][(rgb >> 8) & 0xFF];
+	const _yuv32_t *b = &s->yuv_level_lookup[2][(rgb >> 0) & 0xFF];
+	int32_t y, u, v;
+	
+	y = r->y + g->y + b->y;
+	u = r->u + g->u + b->u;
+	v = r->v + g->v + b->v;
+	
+	/* Limit magnitude of D/D2-MAC chrominance */
+	if(s->yuv_mac_limit)
+	{
+		int32_t m = abs(u) > abs(v) ? abs(u) : abs(v);
+		
+		if(m > s->yuv_mac_limit)
+		{
+			u = (int64_t) u * s->yuv_mac_limit / m;
+			v = (int64_t) v * s->yuv_mac_limit / m;
+		}
+	}
+	
+	return((_yuv16_t) { _vid_yuv_limit(y), _vid_yuv_limit(u), _vid_yuv_limit(v) });
+}
+
+/* Cosine and sine of a 32-bit phase from a quarter-wave table */
+static inline void vid_fm_nco(const cint16_t *lut, uint32_t phase, int32_t *i, int32_t *q)
+{
+	int32_t c, s, d, m, t;
+	const cint16_t *v;
+	
+	/* Cosine and sine at the start of the table step */
+	v = &lut[((phase >> (32 - FM_NCO_QUARTER_BITS - 2)) & (FM_NCO_QUARTER - 1)) * 2];
+	
+	/* The remaining fraction of the step, 16 bits */
+	d = (phase >> (16 - FM_NCO_QUARTER_BITS - 2)) & 0xFFFF;
+	
+	/* cos(x + d) ~= cos(x) - d sin(x), sin(x + d) ~= sin(x) + d cos(x) */
+	c = v[0].i - ((v[1].q * d + (1 << (15 + FM_NCO_DSHIFT))) >> (16 + FM_NCO_DSHIFT));
+	s = v[0].q + ((v[1].i * d + (1 << (15 + FM_NCO_DSHIFT))) >> (16 + FM_NCO_DSHIFT));
+	
+	/* Rotate into the quadrant. Masks are used rather
+	 * than branches as the phase is unpredictable */
+	m = (int32_t) (phase << 1) >> 31;
+	t = (c ^ s) & m;
+	c ^= t;
+	s ^= t;
+	
+	m = (int32_t) phase >> 31;
+	*q = (s ^ m) - m;
+	
+	m = (int32_t) (phase ^ (phase << 1)) >> 31;
+	*i = (c ^ m) - m;
+}
+
 extern int vid_init(vid_t *s, unsigned int sample_rate, unsigned int pixel_rate, const vid_config_t * const conf);
 extern void vid_free(vid_t *s);
 extern void vid_info(vid_t *s);
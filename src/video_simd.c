@@ -0,0 +1,421 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Active video kernels for the raster renderer. Each kernel has a
+ * plain C version, and the fastest one supported by the CPU is
+ * selected at runtime. All versions produce identical output. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "video.h"
+#include "cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void vid_rgb_scalar(const vid_t *s, int16_t *o, int16_t *oc, const uint32_t *rgb, int stride, int n)
+{
+	_yuv16_t yuv;
+	int x;
+	
+	for(x = 0; x < n; x++, o += 2, rgb += stride)
+	{
+		yuv = vid_rgb_to_yuv(s, *rgb);
+		
+		*o = yuv.y;
+		
+		if(oc)
+		{
+			*(oc++) = yuv.u;
+			*(oc++) = yuv.v;
+		}
+	}
+}
+
+void vid_mix_scalar(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n)
+{
+	int x;
+	
+	for(x = 0; x < n; x++, o += 2, oc += 2)
+	{
+		*o += (lut[x].i * oc[1] * pal +
+		       lut[x].q * oc[0]) >> 15;
+	}
+}
+
+void vid_nco_scalar(int16_t *o, const uint32_t *phase, const cint16_t *lut, int n)
+{
+	int32_t i, q;
+	int x;
+	
+	for(x = 0; x < n; x++, o += 2)
+	{
+		vid_fm_nco(lut, phase[x], &i, &q);
+		o[0] = i;
+		o[1] = q;
+	}
+}
+
+void vid_cmul_scalar(int16_t *o, const int16_t *c, int n)
+{
+	int32_t i, q;
+	int x;
+	
+	for(x = 0; x < n; x++, o += 2, c += 2)
+	{
+		i = o[0] * c[0] - o[1] * c[1];
+		q = o[0] * c[1] + o[1] * c[0];
+		o[0] = i >> 15;
+		o[1] = q >> 15;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2")))
+static inline __m256i _yuv_limit_avx2(__m256i v)
+{
+	__m256i a;
+	
+	/* The same rounding and limits as _vid_yuv_limit() */
+	a = _mm256_abs_epi32(v);
+	a = _mm256_add_epi32(a, _mm256_set1_epi32(1 << (VID_YUV_SHIFT - 1)));
+	a = _mm256_srli_epi32(a, VID_YUV_SHIFT);
+	a = _mm256_sign_epi32(a, v);
+	a = _mm256_max_epi32(a, _mm256_set1_epi32(-INT16_MAX));
+	a = _mm256_min_epi32(a, _mm256_set1_epi32(INT16_MAX));
+	
+	return(a);
+}
+
+__attribute__((target("avx2")))
+void vid_rgb_avx2(const vid_t *s, int16_t *o, int16_t *oc, const uint32_t *rgb, int stride, int n)
+{
+	/* The lookup tables are gathered as an array of int32's, three
+	 * per entry (y, u, v), with the G and B tables following R */
+	const int *lut = (const int *) s->yuv_level_lookup;
+	const __m256i m = _mm256_set1_epi32(0xFF);
+	const __m256i three = _mm256_set1_epi32(3);
+	const __m256i idx = _mm256_mullo_epi32(
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+		_mm256_set1_epi32(stride)
+	);
+	__m256i p, ir, ig, ib, y, u, v;
+	int x;
+	
+	if(s->yuv_mac_limit)
+	{
+		/* The D/D2-MAC chrominance limit has no vector version */
+		vid_rgb_scalar(s, o, oc, rgb, stride, n);
+		return;
+	}
+	
+	for(x = 0; x + 8 <= n; x += 8, o += 16, rgb += stride * 8)
+	{
+		if(stride == 1)
+		{
+			p = _mm256_loadu_si256((const __m256i *) rgb);
+		}
+		else
+		{
+			p = _mm256_i32gather_epi32((const int *) rgb, idx, 4);
+		}
+		
+		/* Table offsets for each channel */
+		ir = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 16), m), three);
+		ig = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 8), m), three);
+		ib = _mm256_mullo_epi32(_mm256_and_si256(p, m), three);
+		ig = _mm256_add_epi32(ig, _mm256_set1_epi32(0x100 * 3));
+		ib = _mm256_add_epi32(ib, _mm256_set1_epi32(0x200 * 3));
+		
+		y = _mm256_add_epi32(
+			_mm256_add_epi32(
+				_mm256_i32gather_epi32(lut, ir, 4),
+				_mm256_i32gather_epi32(lut, ig, 4)
+			),
+			_mm256_i32gather_epi32(lut, ib, 4)
+		);
+		y = _yuv_limit_avx2(y);
+		
+		/* Replace the even samples of the output, keeping the odd */
+		p = _mm256_loadu_si256((const __m256i *) o);
+		p = _mm256_blend_epi16(p, y, 0x55);
+		_mm256_storeu_si256((__m256i *) o, p);
+		
+		if(oc)
+		{
+			u = _mm256_add_epi32(
+				_mm256_add_epi32(
+					_mm256_i32gather_epi32(lut + 1, ir, 4),
+					_mm256_i32gather_epi32(lut + 1, ig, 4)
+				),
+				_mm256_i32gather_epi32(lut + 1, ib, 4)
+			);
+			
+			v = _mm256_add_epi32(
+				_mm256_add_epi32(
+					_mm256_i32gather_epi32(lut + 2, ir, 4),
+					_mm256_i32gather_epi32(lut + 2, ig, 4)
+				),
+				_mm256_i32gather_epi32(lut + 2, ib, 4)
+			);
+			
+			u = _yuv_limit_avx2(u);
+			v = _yuv_limit_avx2(v);
+			
+			/* Interleave as U/V pairs */
+			p = _mm256_blend_epi16(u, _mm256_slli_epi32(v, 16), 0xAA);
+			_mm256_storeu_si256((__m256i *) oc, p);
+			
+			oc += 16;
+		}
+	}
+	
+	vid_rgb_scalar(s, o, oc, rgb, stride, n - x);
+}
+
+__attribute__((target("sse4.1")))
+void vid_mix_sse41(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n)
+{
+	/* Multiply the I part of the subcarrier by pal. The subcarrier
+	 * never reaches -32768, so this can't overflow */
+	const __m128i sign = _mm_set1_epi32((1 << 16) | (uint16_t) pal);
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	__m128i a, b, c;
+	int x;
+	
+	for(x = 0; x + 4 <= n; x += 4, o += 8, oc += 8)
+	{
+		a = _mm_loadu_si128((const __m128i *) &lut[x]);
+		b = _mm_loadu_si128((const __m128i *) oc);
+		
+		/* I * V * pal + Q * U */
+		a = _mm_sign_epi16(a, sign);
+		b = _mm_or_si128(_mm_srli_epi32(b, 16), _mm_slli_epi32(b, 16));
+		a = _mm_srai_epi32(_mm_madd_epi16(a, b), 15);
+		
+		/* Add to the even samples only */
+		c = _mm_loadu_si128((const __m128i *) o);
+		c = _mm_add_epi16(c, _mm_and_si128(a, mask));
+		_mm_storeu_si128((__m128i *) o, c);
+	}
+	
+	vid_mix_scalar(o, oc, &lut[x], pal, n - x);
+}
+
+__attribute__((target("avx2")))
+void vid_mix_avx2(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n)
+{
+	const __m256i sign = _mm256_set1_epi32((1 << 16) | (uint16_t) pal);
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	__m256i a, b, c;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8, o += 16, oc += 16)
+	{
+		a = _mm256_loadu_si256((const __m256i *) &lut[x]);
+		b = _mm256_loadu_si256((const __m256i *) oc);
+		
+		a = _mm256_sign_epi16(a, sign);
+		b = _mm256_or_si256(_mm256_srli_epi32(b, 16), _mm256_slli_epi32(b, 16));
+		a = _mm256_srai_epi32(_mm256_madd_epi16(a, b), 15);
+		
+		c = _mm256_loadu_si256((const __m256i *) o);
+		c = _mm256_add_epi16(c, _mm256_and_si256(a, mask));
+		_mm256_storeu_si256((__m256i *) o, c);
+	}
+	
+	vid_mix_scalar(o, oc, &lut[x], pal, n - x);
+}
+
+__attribute__((target("avx2")))
+void vid_nco_avx2(int16_t *o, const uint32_t *phase, const cint16_t *lut, int n)
+{
+	const __m256i qmask = _mm256_set1_epi32(FM_NCO_QUARTER - 1);
+	const __m256i dmask = _mm256_set1_epi32(0xFFFF);
+	const __m256i round = _mm256_set1_epi32(1 << (15 + FM_NCO_DSHIFT));
+	__m256i p, v, dv, c, s, dc, ds, d, m, t;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8, o += 16)
+	{
+		p = _mm256_loadu_si256((const __m256i *) &phase[x]);
+		
+		/* Each table entry is a 32-bit I/Q pair, and each step
+		 * has a pair of entries */
+		v = _mm256_srli_epi32(p, 32 - FM_NCO_QUARTER_BITS - 2);
+		v = _mm256_and_si256(v, qmask);
+		dv = _mm256_i32gather_epi32((const int *) lut + 1, v, 8);
+		v = _mm256_i32gather_epi32((const int *) lut, v, 8);
+		
+		c = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+		s = _mm256_srai_epi32(v, 16);
+		dc = _mm256_srai_epi32(_mm256_slli_epi32(dv, 16), 16);
+		ds = _mm256_srai_epi32(dv, 16);
+		
+		d = _mm256_and_si256(_mm256_srli_epi32(p, 16 - FM_NCO_QUARTER_BITS - 2), dmask);
+		
+		t = _mm256_add_epi32(_mm256_mullo_epi32(ds, d), round);
+		c = _mm256_sub_epi32(c, _mm256_srai_epi32(t, 16 + FM_NCO_DSHIFT));
+		t = _mm256_add_epi32(_mm256_mullo_epi32(dc, d), round);
+		s = _mm256_add_epi32(s, _mm256_srai_epi32(t, 16 + FM_NCO_DSHIFT));
+		
+		/* Rotate into the quadrant */
+		m = _mm256_srai_epi32(_mm256_slli_epi32(p, 1), 31);
+		t = _mm256_and_si256(_mm256_xor_si256(c, s), m);
+		c = _mm256_xor_si256(c, t);
+		s = _mm256_xor_si256(s, t);
+		
+		m = _mm256_srai_epi32(p, 31);
+		s = _mm256_sub_epi32(_mm256_xor_si256(s, m), m);
+		
+		m = _mm256_srai_epi32(_mm256_xor_si256(p, _mm256_slli_epi32(p, 1)), 31);
+		c = _mm256_sub_epi32(_mm256_xor_si256(c, m), m);
+		
+		v = _mm256_or_si256(_mm256_and_si256(c, dmask), _mm256_slli_epi32(s, 16));
+		_mm256_storeu_si256((__m256i *) o, v);
+	}
+	
+	vid_nco_scalar(o, &phase[x], lut, n - x);
+}
+
+__attribute__((target("avx2")))
+void vid_cmul_avx2(int16_t *o, const int16_t *c, int n)
+{
+	const __m256i conj = _mm256_set1_epi32(0xFFFF0001);
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	const __m256i swap = _mm256_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13
+	);
+	__m256i v, w, i, q;
+	int x;
+	
+	for(x = 0; x + 8 <= n; x += 8, o += 16, c += 16)
+	{
+		v = _mm256_loadu_si256((const __m256i *) o);
+		w = _mm256_loadu_si256((const __m256i *) c);
+		
+		/* I = o.i * c.i - o.q * c.q, Q = o.i * c.q + o.q * c.i. The
+		 * pair sums cannot overflow while c avoids INT16_MIN */
+		i = _mm256_madd_epi16(v, _mm256_sign_epi16(w, conj));
+		q = _mm256_madd_epi16(v, _mm256_shuffle_epi8(w, swap));
+		
+		i = _mm256_srai_epi32(i, 15);
+		q = _mm256_srai_epi32(q, 15);
+		
+		/* Keep the low 16 bits, as the C version does */
+		v = _mm256_or_si256(_mm256_and_si256(i, mask), _mm256_slli_epi32(q, 16));
+		_mm256_storeu_si256((__m256i *) o, v);
+	}
+	
+	vid_cmul_scalar(o, c, n - x);
+}
+
+#endif
+
+#if defined(__ARM_NEON)
+
+void vid_mix_neon(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n)
+{
+	int16x4x2_t l, c, d;
+	int32x4_t a;
+	int x;
+	
+	for(x = 0; x + 4 <= n; x += 4, o += 8, oc += 8)
+	{
+		l = vld2_s16(&lut[x].i);
+		c = vld2_s16(oc);
+		d = vld2_s16(o);
+		
+		/* I * V * pal + Q * U */
+		a = vmull_s16(l.val[0], c.val[1]);
+		if(pal < 0) a = vnegq_s32(a);
+		a = vmlal_s16(a, l.val[1], c.val[0]);
+		
+		/* Narrowing keeps the low 16 bits, as the C version does */
+		d.val[0] = vadd_s16(d.val[0], vmovn_s32(vshrq_n_s32(a, 15)));
+		vst2_s16(o, d);
+	}
+	
+	vid_mix_scalar(o, oc, &lut[x], pal, n - x);
+}
+
+void vid_cmul_neon(int16_t *o, const int16_t *c, int n)
+{
+	int16x4x2_t a, b;
+	int32x4_t i, q;
+	int x;
+	
+	for(x = 0; x + 4 <= n; x += 4, o += 8, c += 8)
+	{
+		a = vld2_s16(o);
+		b = vld2_s16(c);
+		
+		i = vmull_s16(a.val[0], b.val[0]);
+		i = vmlsl_s16(i, a.val[1], b.val[1]);
+		q = vmull_s16(a.val[0], b.val[1]);
+		q = vmlal_s16(q, a.val[1], b.val[0]);
+		
+		a.val[0] = vmovn_s32(vshrq_n_s32(i, 15));
+		a.val[1] = vmovn_s32(vshrq_n_s32(q, 15));
+		vst2_s16(o, a);
+	}
+	
+	vid_cmul_scalar(o, c, n - x);
+}
+
+#endif
+
+void vid_simd_init(vid_t *s)
+{
+	int f = cpu_features();
+	
+	s->rgb_kernel = vid_rgb_scalar;
+	s->mix_kernel = vid_mix_scalar;
+	s->nco_kernel = vid_nco_scalar;
+	s->cmul_kernel = vid_cmul_scalar;
+	
+#if defined(__x86_64__) || defined(__i386__)
+	if(f & CPU_SSE41)
+	{
+		s->mix_kernel = vid_mix_sse41;
+	}
+	
+	if(f & CPU_AVX2)
+	{
+		s->rgb_kernel = vid_rgb_avx2;
+		s->mix_kernel = vid_mix_avx2;
+		s->nco_kernel = vid_nco_avx2;
+		s->cmul_kernel = vid_cmul_avx2;
+	}
+#elif defined(__ARM_NEON)
+	if(f & CPU_NEON)
+	{
+		s->mix_kernel = vid_mix_neon;
+		s->cmul_kernel = vid_cmul_neon;
+	}
+#else
+	(void) f;
+#endif
+}
+
@@ -0,0 +1,91 @@
+/* hacktv - Analogue video transmitter for the HackRF                    */
+/*=======================================================================*/
+/* Copyright 2026 Philip Heron <phil@sanslogic.co.uk>                    */
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _VIDEO_SIMD_H
+#define _VIDEO_SIMD_H
+
+#include <stdint.h>
+#include "common.h"
+
+/* Convert a run of RGB pixels to signal levels.
+ *
+ * o: Output line, Y is written to every other sample (o[x * 2])
+ * oc: Chrominance buffer for interleaved U/V pairs, or NULL if not needed
+ * rgb: First pixel
+ * stride: Distance between pixels
+ * n: Number of pixels
+ *
+ * The result matches vid_rgb_to_yuv() for each pixel.
+*/
+typedef void (*vid_rgb_kernel_t)(const vid_t *s, int16_t *o, int16_t *oc, const uint32_t *rgb, int stride, int n);
+
+/* Modulate the U/V chrominance onto the colour subcarrier.
+ *
+ * o: Output, every other sample is updated (o[x * 2])
+ * oc: Interleaved U/V pairs
+ * lut: Subcarrier for each sample
+ * pal: 1, or -1 to invert the V component (PAL V-switch)
+ * n: Number of samples
+ *
+ * Each sample has (lut.i * v * pal + lut.q * u) >> 15 added.
+*/
+typedef void (*vid_mix_kernel_t)(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n);
+
+/* Generate a carrier from a run of phases, for the FM modulator.
+ *
+ * o: Output, interleaved I/Q pairs
+ * phase: Phase of each sample, a full turn is 2^32
+ * lut: Quarter-wave cosine and sine table
+ * n: Number of samples
+ *
+ * The result matches vid_fm_nco() for each sample.
+*/
+typedef void (*vid_nco_kernel_t)(int16_t *o, const uint32_t *phase, const cint16_t *lut, int n);
+
+/* Multiply a run of samples by a carrier, for the offset mixer.
+ *
+ * o: Samples to update, interleaved I/Q pairs
+ * c: Carrier, interleaved I/Q pairs, no component may be INT16_MIN
+ * n: Number of samples
+ *
+ * The result matches cint16_mul() for each sample.
+*/
+typedef void (*vid_cmul_kernel_t)(int16_t *o, const int16_t *c, int n);
+
+extern void vid_rgb_scalar(const vid_t *s, int16_t *o, int16_t *oc, const uint32_t *rgb, int stride, int n);
+extern void vid_mix_scalar(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n);
+extern void vid_nco_scalar(int16_t *o, const uint32_t *phase, const cint16_t *lut, int n);
+extern void vid_cmul_scalar(int16_t *o, const int16_t *c, int n);
+
+#if defined(__x86_64__) || defined(__i386__)
+extern void vid_rgb_avx2(const vid_t *s, int16_t *o, int16_t *oc, const uint32_t *rgb, int stride, int n);
+extern void vid_mix_sse41(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n);
+extern void vid_mix_avx2(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n);
+extern void vid_nco_avx2(int16_t *o, const uint32_t *phase, const cint16_t *lut, int n);
+extern void vid_cmul_avx2(int16_t *o, const int16_t *c, int n);
+#endif
+
+#if defined(__ARM_NEON)
+extern void vid_mix_neon(int16_t *o, const int16_t *oc, const cint16_t *lut, int pal, int n);
+extern void vid_cmul_neon(int16_t *o, const int16_t *c, int n);
+#endif
+
+/* Select the fastest kernels supported by this CPU */
+extern void vid_simd_init(vid_t *s);
+
+#endif
+